@@ -0,0 +1,55 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "agc.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static float coefficient(const float seconds, const float blockRate) {
+    return std::exp(-1.0f / (seconds * blockRate));
+}
+
+void AGC::init(const int bands, const float blockRate) {
+    this->attack = coefficient(AGC_ATTACK_SECONDS, blockRate);
+    this->release = coefficient(AGC_RELEASE_SECONDS, blockRate);
+    this->floorRise = coefficient(AGC_FLOOR_RISE_SECONDS, blockRate);
+    this->floorFall = coefficient(AGC_FLOOR_FALL_SECONDS, blockRate);
+
+    this->loudness = AGC_MIN_LOUDNESS;
+    this->amplitudePeak = AGC_MIN_LOUDNESS;
+    this->noiseFloor.assign(bands, 0.0f);
+}
+
+float AGC::follow(const float current, const float target) const {
+    const float coeff = target > current ? this->attack : this->release;
+    return coeff * current + (1 - coeff) * target;
+}
+
+void AGC::process(float* bands) {
+    const int count = static_cast<int>(this->noiseFloor.size());
+
+    float peak = 0;
+    for (int i = 0; i < count; ++i) {
+        // Compress on the CPU once per band instead of once per pixel in the shader
+        const float level = std::log1p(bands[i]);
+        float &floor = this->noiseFloor[i];
+        const float coeff = level < floor ? this->floorFall : this->floorRise;
+        floor = coeff * floor + (1 - coeff) * level;
+
+        bands[i] = std::max(level - floor, 0.0f);
+        peak = std::max(peak, bands[i]);
+    }
+
+    this->loudness = std::max(this->follow(this->loudness, peak), AGC_MIN_LOUDNESS);
+    const float gain = 1.0f / this->loudness;
+    for (int i = 0; i < count; ++i) {
+        bands[i] = std::min(bands[i] * gain, 1.0f);
+    }
+}
+
+float AGC::normalizeAmplitude(const float amplitude) {
+    this->amplitudePeak = std::max(this->follow(this->amplitudePeak, amplitude), AGC_MIN_LOUDNESS);
+    return std::min(amplitude / this->amplitudePeak, 1.0f);
+}
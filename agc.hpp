@@ -0,0 +1,37 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef AGC_HPP
+#define AGC_HPP
+
+#define AGC_ATTACK_SECONDS 0.05f
+#define AGC_RELEASE_SECONDS 8.0f
+#define AGC_FLOOR_RISE_SECONDS 10.0f
+#define AGC_FLOOR_FALL_SECONDS 0.5f
+#define AGC_MIN_LOUDNESS 0.05f
+
+#include <vector>
+
+// Normalizes log bands and amplitude into a stable 0-1 range by tracking a
+// per-band noise floor and the long-term loudness above it.
+class AGC {
+    float attack = 0;
+    float release = 0;
+    float floorRise = 0;
+    float floorFall = 0;
+
+    float loudness = AGC_MIN_LOUDNESS;
+    float amplitudePeak = AGC_MIN_LOUDNESS;
+    std::vector<float> noiseFloor;
+
+    float follow(float current, float target) const;
+public:
+    void init(int bands, float blockRate);
+    void process(float* bands);
+    float normalizeAmplitude(float amplitude);
+};
+
+
+
+#endif //AGC_HPP
@@ -0,0 +1,133 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "alloctrack.hpp"
+
+#include "colorcli.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+
+#ifdef TRACK_ALLOCATIONS
+
+// glibc exports its allocator under these names, which lets the hooks below
+// interpose malloc for the whole process (including C libraries like libzmq)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* memory, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+
+struct AllocationRecord {
+    const char* thread;
+    size_t size;
+};
+
+static thread_local const char* realtimeThread = nullptr;
+static thread_local int driverDepth = 0;
+static std::atomic<bool> tracking = false;
+static std::atomic<uint64_t> allocations = 0;
+static std::atomic<uint64_t> driverAllocations = 0;
+static AllocationRecord records[ALLOCATION_RECORDS];
+
+static void track(const size_t size) {
+    if (realtimeThread == nullptr || !tracking.load(std::memory_order_relaxed)) return;
+    if (driverDepth > 0) {
+        driverAllocations.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (const uint64_t index = allocations.fetch_add(1, std::memory_order_relaxed); index < ALLOCATION_RECORDS) {
+        records[index] = {realtimeThread, size};
+    }
+}
+
+extern "C" void* malloc(const size_t size) {
+    track(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(const size_t count, const size_t size) {
+    track(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* memory, const size_t size) {
+    track(size);
+    return __libc_realloc(memory, size);
+}
+
+extern "C" void* memalign(const size_t alignment, const size_t size) {
+    track(size);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(const size_t alignment, const size_t size) {
+    track(size);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** memory, const size_t alignment, const size_t size) {
+    track(size);
+    *memory = __libc_memalign(alignment, size);
+    return *memory == nullptr ? ENOMEM : 0;
+}
+
+bool allocationTrackingAvailable() {
+    return true;
+}
+
+void registerRealtimeThread(const char* name) {
+    realtimeThread = name;
+}
+
+DriverScope::DriverScope() {
+    ++driverDepth;
+}
+
+DriverScope::~DriverScope() {
+    --driverDepth;
+}
+
+void startAllocationTracking() {
+    allocations = 0;
+    driverAllocations = 0;
+    tracking = true;
+}
+
+uint64_t stopAllocationTracking() {
+    tracking = false;
+    return allocations;
+}
+
+void reportAllocations() {
+    if (const uint64_t driver = driverAllocations; driver > 0) {
+        printf("%s%lu allocations%s inside the GL driver (not counted)\n", CLI_YELLOW, static_cast<unsigned long>(driver), CLI_RESET);
+    }
+    const uint64_t count = allocations;
+    if (count == 0) {
+        printf("%sNo allocations%s on real-time threads\n", CLI_GREEN, CLI_RESET);
+        return;
+    }
+    printf("%s%lu allocations%s on real-time threads:\n", CLI_RED, static_cast<unsigned long>(count), CLI_RESET);
+    for (uint64_t i = 0; i < std::min<uint64_t>(count, ALLOCATION_RECORDS); ++i) {
+        printf("  %s%s%s: %zu bytes\n", CLI_YELLOW, records[i].thread, CLI_RESET, records[i].size);
+    }
+}
+
+#else
+
+bool allocationTrackingAvailable() {
+    return false;
+}
+
+DriverScope::DriverScope() {}
+DriverScope::~DriverScope() {}
+void registerRealtimeThread(const char*) {}
+void startAllocationTracking() {}
+uint64_t stopAllocationTracking() { return 0; }
+void reportAllocations() {}
+
+#endif
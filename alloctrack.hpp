@@ -0,0 +1,32 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef ALLOCTRACK_HPP
+#define ALLOCTRACK_HPP
+
+#define ALLOCATION_RECORDS 64
+
+#include <cstdint>
+
+// Counts heap allocations made on registered real-time threads while tracking is enabled.
+// Only active when built with TRACK_ALLOCATIONS, otherwise all functions are no-ops.
+bool allocationTrackingAvailable();
+void registerRealtimeThread(const char* name);
+void startAllocationTracking();
+uint64_t stopAllocationTracking();
+void reportAllocations();
+
+// Allocations made by the GL driver while a DriverScope is alive are reported separately
+// and do not fail the check, they are outside of our control.
+class DriverScope {
+public:
+    DriverScope();
+    ~DriverScope();
+    DriverScope(const DriverScope&) = delete;
+    DriverScope& operator=(const DriverScope&) = delete;
+};
+
+
+
+#endif //ALLOCTRACK_HPP
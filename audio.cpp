@@ -7,145 +7,132 @@
 
 #include "audio.hpp"
 
+#include <algorithm>
 #include <cmath>
 
 #include "colorcli.hpp"
+#include "metrics.hpp"
+#include "realtime.hpp"
+#include "simd.hpp"
+#include "timing.hpp"
 
-#include <iostream>
-#include <stdexcept>
 #include <vector>
 
-void Audio::initPortAudio() {
-    
-    if (const PaError err = Pa_Initialize(); err != paNoError) {
-        throw std::runtime_error("Cannot initialize PortAudio: " + std::to_string(err));
-    }
+void Audio::publish(const int64_t captureTime, const float amplitude) {
+    const uint64_t index = this->publishedFrames.load(std::memory_order_relaxed);
+    AnalysisFrame &frame = this->frames[index % FRAME_RING_LENGTH];
 
-    const int numDevices = Pa_GetDeviceCount();
-    if (numDevices < 0) {
-        Pa_Terminate();
-        throw std::runtime_error("Cannot get Device Count.");
+    for (int channel = 0; channel < this->channels; ++channel) {
+        this->agc[channel].process(&this->bands[channel*LOG_BANDS]);
     }
-    std::vector<PaDeviceIndex> inputDevices;
-    for (int i = 0; i < numDevices; i++) {
-        if (const PaDeviceInfo *deviceInfo = Pa_GetDeviceInfo(i); deviceInfo->maxInputChannels > 0) {
-            inputDevices.push_back(i);
-        }
+    if (this->channels >= 2) {
+        this->stereo.process(this->fft.spectrum(), this->fft.spectrum() + FFW_BANDS, this->bandMapper.bandStart(), this->bandMapper.bandEnd());
     }
 
-    printf("Found %s%zd%s devices: \n", CLI_RED, inputDevices.size(), CLI_RESET);
-    for (size_t i = 0; i < inputDevices.size(); i++) {
-        const PaDeviceIndex devIndex = inputDevices[i];
-        printf(CLI_BLUE "%zd%s: %s%s%s\n", i+1, CLI_RESET, CLI_YELLOW, Pa_GetDeviceInfo(devIndex)->name, CLI_RESET);
+    frame.captureTime = captureTime;
+    frame.channels = this->channels;
+    frame.amplitude = this->agc[0].normalizeAmplitude(amplitude);
+    std::copy_n(*this->fft.spectrum(), this->channels*FFW_BANDS*2, *frame.spectrum);
+    std::copy(this->bands.begin(), this->bands.end(), frame.bands);
+    std::copy(this->stereo.result().begin(), this->stereo.result().end(), frame.stereo);
+    for (int column = 0; column < WAVEFORM_COLUMNS; ++column) {
+        minMax(this->fft.planar() + column*WAVEFORM_DECIMATION, WAVEFORM_DECIMATION, frame.waveform[column*2], frame.waveform[column*2 + 1]);
     }
-    printf("Select Device Numer: ");
-    int selectedDeviceNr;
-    std::cin >> selectedDeviceNr;
-
-    this->deviceIndex = inputDevices[selectedDeviceNr-1];
 
-    const PaDeviceInfo *deviceInfo = Pa_GetDeviceInfo(this->deviceIndex);
-    printf("Selected Device %d: %s\n", selectedDeviceNr, deviceInfo->name);
+    this->publishedFrames.store(index + 1, std::memory_order_release);
 }
 
-void Audio::initFFTW() {
-    this->result = static_cast<fftwf_complex *>(fftwf_malloc(sizeof(fftwf_complex) * (FFW_BANDS)));
+static uint64_t oldestReadable(const uint64_t published) {
+    return published > FRAME_RING_LENGTH - FRAME_RING_GUARD ? published - (FRAME_RING_LENGTH - FRAME_RING_GUARD) : 0;
 }
 
-void Audio::computeLogBands() {
-    const float maxFreq = static_cast<float>(this->sampleRate) / 2;
-    
-    std::vector<float> bandEdges(LOG_BANDS+1);
-    for (int i = 0; i <= LOG_BANDS; ++i) {
-        const float fraction = static_cast<float>(i) / LOG_BANDS;
-        bandEdges[i] = LOG_MIN_FREQ * std::pow(maxFreq / LOG_MIN_FREQ, fraction);
-    }
-
-    const float binHz = static_cast<float>(this->sampleRate) / FRAMES_PER_BUFFER;
-
-    for (int band = 0; band < LOG_BANDS; ++band) {
-        const float lowFreq = bandEdges[band];
-        const float highFreq = bandEdges[band + 1];
+const AnalysisFrame* Audio::frameAt(const int64_t captureDeadline, uint64_t& index) const {
+    const uint64_t published = this->publishedFrames.load(std::memory_order_acquire);
+    if (published == 0) return nullptr;
 
-        const int startBin = std::ceil(lowFreq / binHz);
-        const int endBin = std::floor(highFreq / binHz);
-
-        float sum = 0.0;
-        int count = 0;
+    const uint64_t oldest = oldestReadable(published);
+    for (index = published - 1; index > oldest; --index) {
+        if (this->frame(index).captureTime <= captureDeadline) break;
+    }
+    return &this->frame(index);
+}
 
-        for (int i = startBin; i <= endBin && i < FFW_BANDS; ++i) {
-            const float magnitude = std::sqrt(this->result[i][0]*this->result[i][0]+this->result[i][1]*this->result[i][1]);
-            sum += magnitude;
-            ++count;
-        }
+uint64_t Audio::oldestFrame() const {
+    return oldestReadable(this->publishedFrames.load(std::memory_order_acquire));
+}
 
-        if (count > 0)
-            (*this->logResult)[band] = sum / static_cast<float>(count); // or just sum, or max, depending on your goal
-        else
-            (*this->logResult)[band] = 0.0;
-    }
+void Audio::prefault() {
+    ::prefault(this->fft.planar(), this->fft.inputBytes());
+    ::prefault(this->fft.spectrum(), this->fft.outputBytes());
+    ::prefault(this->bands.data(), this->bands.size() * sizeof(float));
+    ::prefault(this->frames.get(), sizeof(AnalysisFrame) * FRAME_RING_LENGTH);
+    prefaultStack();
 }
 
-void Audio::init() {
-    this->initPortAudio();
-    this->initFFTW();
+void Audio::init(std::unique_ptr<AudioSource> source) {
+    this->source = std::move(source);
+    this->source->init();
+    this->fft.allocate(FRAMES_PER_BUFFER, MAX_CHANNELS);
 }
 
 void Audio::start() {
-    const PaDeviceInfo *deviceInfo = Pa_GetDeviceInfo(this->deviceIndex);
-    
-    PaStreamParameters inputParameters;
-    inputParameters.device = this->deviceIndex;
-    inputParameters.channelCount = 1;
-    inputParameters.sampleFormat = paFloat32;
-    inputParameters.suggestedLatency = deviceInfo->defaultLowInputLatency;
-    inputParameters.hostApiSpecificStreamInfo = nullptr;
-
-    this->sampleRate = deviceInfo->defaultSampleRate;
-    
-    if (const PaError err = Pa_OpenStream(&this->stream, &inputParameters, nullptr,
-            sampleRate, FRAMES_PER_BUFFER, paClipOff,
-        nullptr, nullptr); err != paNoError) {
-        throw std::runtime_error("Cannot open Audio Stream: " + std::to_string(err));
-    }
+    this->source->start(MAX_CHANNELS);
+    this->channels = this->source->channels();
+    this->sampleRate = this->source->sampleRate();
 
-    if (const PaError err = Pa_StartStream(this->stream); err != paNoError) {
-        this->stop();
-        throw std::runtime_error("Cannot start Audio Stream: " + std::to_string(err));
+    this->agc.resize(this->channels);
+    for (AGC &channelAgc : this->agc) {
+        channelAgc.init(LOG_BANDS, static_cast<float>(this->sampleRate) / FRAMES_PER_BUFFER);
     }
+    this->stereo.init(LOG_BANDS, static_cast<float>(this->sampleRate) / FRAMES_PER_BUFFER);
+    this->bandMapper.init(LOG_BANDS, FRAMES_PER_BUFFER, this->sampleRate, LOG_MIN_FREQ);
 
-    float paBuffer[FRAMES_PER_BUFFER*deviceInfo->maxInputChannels];
-    fftwf_plan plan = fftwf_plan_dft_r2c_1d(FRAMES_PER_BUFFER, paBuffer, this->result, FFTW_EXHAUSTIVE | FFTW_NO_BUFFERING | FFTW_NO_SLOW);
-
-    while (this->running) {
-        if (const PaError err = Pa_ReadStream(this->stream, paBuffer, FRAMES_PER_BUFFER)) {
-            this->stop();
-            throw std::runtime_error("Cannot read Audio Stream: " + std::to_string(err));
-        }
-        *this->amplitude = 0;
-        for (int i = 0; i < FRAMES_PER_BUFFER; ++i) {
-            *this->amplitude = std::max(*this->amplitude, std::abs(paBuffer[i]));
-        }
+    float paBuffer[FRAMES_PER_BUFFER*MAX_CHANNELS];
+    this->fft.plan(this->channels, FFTW_EXHAUSTIVE | FFTW_NO_BUFFERING | FFTW_NO_SLOW);
 
-        fftwf_execute(plan);
-
-        this->computeLogBands();
+    if (this->prefaultBuffers) {
+        this->prefault();
+        ::prefault(paBuffer, sizeof(paBuffer));
+    }
 
-        Pa_Sleep(10);
+    while (this->running) {
+        const int64_t waitStart = steadyNanoseconds();
+        const int64_t captureTime = this->source->read(paBuffer);
+        recordStage(Stage::CaptureWait, waitStart, steadyNanoseconds());
+        this->process(paBuffer, captureTime);
         //printf("Read %s%d%s Frames\n", CLI_GREEN, FRAMES_PER_BUFFER, CLI_RESET);
     }
 
     this->stop();
 }
 
-void Audio::stop() const {
-    if (const PaError err = Pa_StopStream(this->stream); err != paNoError) {
-        throw std::runtime_error("Cannot stop Audio Stream: " + std::to_string(err));
+void Audio::process(const float* interleaved, const int64_t captureTime) {
+    float low, high;
+    minMax(interleaved, FRAMES_PER_BUFFER*this->channels, low, high);
+    const float amplitude = std::max(-low, high);
+    if (amplitude >= this->silenceLevel) {
+        this->quietSince = 0;
+        this->silent.store(false, std::memory_order_relaxed);
+    } else if (this->quietSince == 0) {
+        this->quietSince = captureTime;
+    } else if (captureTime - this->quietSince >= SILENCE_HOLD_MS * 1000000LL) {
+        this->silent.store(true, std::memory_order_relaxed);
     }
-    if (const PaError err = Pa_CloseStream(this->stream); err != paNoError) {
-        throw std::runtime_error("Cannot close Audio Stream: " + std::to_string(err));
+
+    {
+        StageTimer timer(Stage::FFT);
+        deinterleave(interleaved, this->fft.planar(), this->channels, FRAMES_PER_BUFFER);
+        this->fft.execute();
     }
-    Pa_Terminate();
 
-    fftwf_free(this->result);
+    StageTimer timer(Stage::Bands);
+    for (int channel = 0; channel < this->channels; ++channel) {
+        this->bandMapper.map(this->fft.spectrum() + channel*FFW_BANDS, &this->bands[channel*LOG_BANDS]);
+    }
+    this->publish(captureTime, amplitude);
+}
+
+void Audio::stop() {
+    this->source->stop();
+    this->fft.destroy();
 }
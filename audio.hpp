@@ -9,31 +9,83 @@
 #define FFW_BANDS (FRAMES_PER_BUFFER/2+1)
 #define LOG_BANDS 128
 #define LOG_MIN_FREQ 20
+#define MAX_CHANNELS 8
+#define HISTORY_LENGTH 256
+#define WAVEFORM_DECIMATION 32
+#define WAVEFORM_COLUMNS (FRAMES_PER_BUFFER/WAVEFORM_DECIMATION)
+#define WAVEFORM_LENGTH 512
+#define FRAME_RING_LENGTH 512
+// Frames this close to being overwritten are never handed to readers
+#define FRAME_RING_GUARD 32
+// Input has to stay below the silence level this long before Audio reports silence
+#define SILENCE_HOLD_MS 3000
 
 #include <portaudio.h>
 #include <fftw3.h>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include "agc.hpp"
+#include "bands.hpp"
+#include "fft.hpp"
+#include "source.hpp"
+#include "stereo.hpp"
+
+// Everything the analysis of one block publishes. Spectra, bands and waveform columns are laid out channel after channel,
+// history and waveform follow the first input.
+struct AnalysisFrame {
+    // steady_clock nanoseconds at which the first sample of the block was captured
+    int64_t captureTime = 0;
+    int channels = 1;
+    float amplitude = 0;
+    fftwf_complex spectrum[FFW_BANDS*MAX_CHANNELS] = {};
+    float bands[LOG_BANDS*MAX_CHANNELS] = {};
+    // Per-band (balance, mid, side, correlation) of the first two channels
+    float stereo[LOG_BANDS*4] = {};
+    // Min/max pairs, each covering WAVEFORM_DECIMATION samples
+    float waveform[WAVEFORM_COLUMNS*2] = {};
+};
+
 class Audio {
-    PaDeviceIndex deviceIndex = paNoDevice;
-    PaStream *stream = nullptr;
+    std::unique_ptr<AudioSource> source;
     int sampleRate = 0;
+    BatchedFFT fft;
 
-    void initPortAudio();
-    void initFFTW();
+    std::vector<AGC> agc;
+    StereoImage stereo;
+    BandMapper bandMapper;
+    std::vector<float> bands = std::vector<float>(LOG_BANDS*MAX_CHANNELS);
 
-    void computeLogBands();
+    std::unique_ptr<AnalysisFrame[]> frames = std::make_unique<AnalysisFrame[]>(FRAME_RING_LENGTH);
+    std::atomic<uint64_t> publishedFrames = 0;
+    int64_t quietSince = 0;
+
+    void publish(int64_t captureTime, float amplitude);
+    void process(const float* interleaved, int64_t captureTime);
 public:
-    void init();
+    void init(std::unique_ptr<AudioSource> source);
     void start();
-    void stop() const;
+    void stop();
+    void prefault();
+
+    // Newest frame captured at or before captureDeadline, or the oldest one still available.
+    // Returns nullptr before the first frame is published.
+    const AnalysisFrame* frameAt(int64_t captureDeadline, uint64_t& index) const;
+    const AnalysisFrame& frame(const uint64_t index) const { return this->frames[index % FRAME_RING_LENGTH]; }
+    // Index of the oldest frame readers may still use, frame() of anything older races the writer
+    uint64_t oldestFrame() const;
     
-    bool running = true;
+    std::atomic<bool> running = true;
+    // Touch all analysis buffers and the thread stack before the capture loop starts
+    bool prefaultBuffers = false;
+    // Linear peak level below which input counts as silence
+    float silenceLevel = 0.001f;
+    // Set once the input stayed below silenceLevel for SILENCE_HOLD_MS, cleared by the first louder block
+    std::atomic<bool> silent = false;
 
-    fftwf_complex* result = nullptr;
-    std::shared_ptr<std::vector<float>> logResult = std::make_shared<std::vector<float>>(LOG_BANDS);
-    std::shared_ptr<float> amplitude = std::make_shared<float>(0);
+    std::atomic<int> channels = 1;
 };
 
 
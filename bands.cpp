@@ -0,0 +1,36 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "bands.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void BandMapper::init(const int bands, const int fftSize, const int sampleRate, const float minFrequency) {
+    const int bins = fftSize / 2 + 1;
+    const float maxFreq = static_cast<float>(sampleRate) / 2;
+    const float binHz = static_cast<float>(sampleRate) / static_cast<float>(fftSize);
+
+    this->start.resize(bands);
+    this->end.resize(bands);
+    for (int band = 0; band < bands; ++band) {
+        const float lowFreq = minFrequency * std::pow(maxFreq / minFrequency, static_cast<float>(band) / static_cast<float>(bands));
+        const float highFreq = minFrequency * std::pow(maxFreq / minFrequency, static_cast<float>(band + 1) / static_cast<float>(bands));
+
+        this->start[band] = std::min(static_cast<int>(std::ceil(lowFreq / binHz)), bins);
+        this->end[band] = std::clamp(static_cast<int>(std::floor(highFreq / binHz)) + 1, this->start[band], bins);
+    }
+}
+
+void BandMapper::map(const fftwf_complex* spectrum, float* bands) const {
+    for (int band = 0; band < this->count(); ++band) {
+        float sum = 0.0;
+        for (int i = this->start[band]; i < this->end[band]; ++i) {
+            sum += std::sqrt(spectrum[i][0]*spectrum[i][0]+spectrum[i][1]*spectrum[i][1]);
+        }
+
+        const int count = this->end[band] - this->start[band];
+        bands[band] = count > 0 ? sum / static_cast<float>(count) : 0.0f;
+    }
+}
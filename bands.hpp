@@ -0,0 +1,27 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef BANDS_HPP
+#define BANDS_HPP
+
+#include <fftw3.h>
+#include <vector>
+
+// Maps FFT bins onto logarithmically spaced bands from minFrequency up to Nyquist
+class BandMapper {
+    std::vector<int> start;
+    std::vector<int> end;
+public:
+    void init(int bands, int fftSize, int sampleRate, float minFrequency);
+    // Mean bin magnitude per band, empty bands are 0
+    void map(const fftwf_complex* spectrum, float* bands) const;
+
+    int count() const { return static_cast<int>(this->start.size()); }
+    const int* bandStart() const { return this->start.data(); }
+    const int* bandEnd() const { return this->end.data(); }
+};
+
+
+
+#endif //BANDS_HPP
@@ -0,0 +1,244 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include <fftw3.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "agc.hpp"
+#include "bands.hpp"
+#include "codec.hpp"
+#include "fft.hpp"
+#include "simd.hpp"
+#include "stereo.hpp"
+#include "timing.hpp"
+
+#define BENCHMARK_SAMPLES 15
+#define BENCHMARK_WARMUP_MS 20
+#define BENCHMARK_SAMPLE_RATE 48000
+// FFT size the band kernels run on, large enough that even 512 bands are mostly populated
+#define BENCHMARK_BAND_FFT_SIZE 4096
+
+static const int fftSizes[] = {256, 512, 1024, 2048, 4096, 8192, 16384};
+static const int bandCounts[] = {32, 64, 128, 256, 512};
+static const int canvasSizes[][2] = {{128, 32}, {256, 64}, {512, 128}, {1024, 256}, {2048, 512}};
+
+struct Options {
+    std::string filter;
+    int minTimeMs = 300;
+};
+
+// Keeps the compiler from dropping work whose result is never read
+static void keep(const void* memory) {
+    asm volatile("" : : "g"(memory) : "memory");
+}
+
+static std::vector<float> noise(const size_t count) {
+    std::mt19937 generator(42);
+    std::uniform_real_distribution distribution(-1.0f, 1.0f);
+    std::vector<float> samples(count);
+    for (float& sample : samples) sample = distribution(generator);
+    return samples;
+}
+
+// Runs kernel in batches sized to fill minTimeMs over BENCHMARK_SAMPLES samples and prints one JSON line.
+// parameters is a JSON fragment ("\"size\":256") identifying the case next to the kernel name.
+static void measure(const Options& options, const char* kernel, const std::string& parameters, const std::function<void()>& kernelFunction) {
+    if (!options.filter.empty() && std::string(kernel).find(options.filter) == std::string::npos) return;
+
+    uint64_t iterations = 0;
+    const int64_t warmupEnd = steadyNanoseconds() + BENCHMARK_WARMUP_MS * 1000000LL;
+    while (steadyNanoseconds() < warmupEnd) {
+        kernelFunction();
+        ++iterations;
+    }
+    const int64_t sampleNanoseconds = options.minTimeMs * 1000000LL / BENCHMARK_SAMPLES;
+    const uint64_t batch = std::max<uint64_t>(1, iterations * sampleNanoseconds / (BENCHMARK_WARMUP_MS * 1000000LL));
+
+    std::vector<double> samples;
+    for (int sample = 0; sample < BENCHMARK_SAMPLES; ++sample) {
+        const int64_t start = steadyNanoseconds();
+        for (uint64_t i = 0; i < batch; ++i) {
+            kernelFunction();
+        }
+        samples.push_back(static_cast<double>(steadyNanoseconds() - start) / static_cast<double>(batch));
+    }
+    std::sort(samples.begin(), samples.end());
+    printf("{\"kernel\":\"%s\",%s,\"ns_median\":%.1f,\"ns_min\":%.1f,\"ns_max\":%.1f,\"iterations\":%lu}\n",
+        kernel, parameters.c_str(), samples[samples.size() / 2], samples.front(), samples.back(),
+        static_cast<unsigned long>(batch * BENCHMARK_SAMPLES));
+    fflush(stdout);
+}
+
+static void benchmarkFFT(const Options& options) {
+    for (const int size : fftSizes) {
+        BatchedFFT fft;
+        fft.allocate(size, 2);
+        // FFTW_EXHAUSTIVE as used by Audio takes minutes to plan the largest sizes, MEASURE is close enough for comparisons
+        fft.plan(2, FFTW_MEASURE | FFTW_NO_BUFFERING | FFTW_NO_SLOW);
+        const std::vector<float> input = noise(size * 2);
+        measure(options, "fft", "\"size\":" + std::to_string(size) + ",\"channels\":2", [&] {
+            std::copy(input.begin(), input.end(), fft.planar());
+            fft.execute();
+            keep(fft.spectrum());
+        });
+        fft.destroy();
+    }
+}
+
+static void benchmarkSampleKernels(const Options& options) {
+    for (const int size : fftSizes) {
+        for (const int channels : {2, 8}) {
+            const std::vector<float> interleaved = noise(size * channels);
+            std::vector<float> planar(size * channels);
+            measure(options, "deinterleave", "\"size\":" + std::to_string(size) + ",\"channels\":" + std::to_string(channels), [&] {
+                deinterleave(interleaved.data(), planar.data(), channels, size);
+                keep(planar.data());
+            });
+        }
+        const std::vector<float> samples = noise(size);
+        measure(options, "minmax", "\"size\":" + std::to_string(size), [&] {
+            float low, high;
+            minMax(samples.data(), size, low, high);
+            keep(&low);
+            keep(&high);
+        });
+    }
+}
+
+static void benchmarkBandKernels(const Options& options) {
+    BatchedFFT fft;
+    fft.allocate(BENCHMARK_BAND_FFT_SIZE, 2);
+    fft.plan(2, FFTW_ESTIMATE);
+    const std::vector<float> input = noise(BENCHMARK_BAND_FFT_SIZE * 2);
+    std::copy(input.begin(), input.end(), fft.planar());
+    fft.execute();
+    constexpr float blockRate = static_cast<float>(BENCHMARK_SAMPLE_RATE) / BENCHMARK_BAND_FFT_SIZE;
+
+    for (const int count : bandCounts) {
+        const std::string parameters = "\"bands\":" + std::to_string(count) + ",\"fft_size\":" + std::to_string(BENCHMARK_BAND_FFT_SIZE);
+        BandMapper mapper;
+        mapper.init(count, BENCHMARK_BAND_FFT_SIZE, BENCHMARK_SAMPLE_RATE, 20);
+        std::vector<float> bands(count);
+        measure(options, "bands", parameters, [&] {
+            mapper.map(fft.spectrum(), bands.data());
+            keep(bands.data());
+        });
+
+        AGC agc;
+        agc.init(count, blockRate);
+        std::vector<float> agcBands(count);
+        measure(options, "agc", "\"bands\":" + std::to_string(count), [&] {
+            std::copy(bands.begin(), bands.end(), agcBands.begin());
+            agc.process(agcBands.data());
+            keep(agcBands.data());
+        });
+
+        StereoImage stereo;
+        stereo.init(count, blockRate);
+        measure(options, "stereo", parameters, [&] {
+            stereo.process(fft.spectrum(), fft.spectrum() + fft.bins(), mapper.bandStart(), mapper.bandEnd());
+            keep(stereo.result().data());
+        });
+    }
+    fft.destroy();
+}
+
+// Spectrum-like bars over black, advancing by one step per frame
+static void drawBars(std::vector<unsigned char>& pixels, const int width, const int height, const int step) {
+    std::fill(pixels.begin(), pixels.end(), 0);
+    for (int x = 0; x < width; ++x) {
+        const int level = (x * 7 + step * 3 + (x * x >> 4)) % height;
+        for (int y = 0; y < level; ++y) {
+            unsigned char* pixel = &pixels[(y * width + x) * 3];
+            pixel[0] = static_cast<unsigned char>(255 * y / height);
+            pixel[1] = static_cast<unsigned char>(255 - 255 * y / height);
+            pixel[2] = 64;
+        }
+    }
+}
+
+static void benchmarkCodec(const Options& options) {
+    for (const auto& [width, height] : canvasSizes) {
+        const std::string parameters = "\"width\":" + std::to_string(width) + ",\"height\":" + std::to_string(height);
+        std::vector<std::vector<unsigned char>> frames(2, std::vector<unsigned char>(width * height * 3));
+        drawBars(frames[0], width, height, 0);
+        drawBars(frames[1], width, height, 1);
+
+        FrameEncoder encoder;
+        encoder.init(width, height);
+        std::vector<unsigned char> output(maxEncodedSize(width * height));
+        WireFrameInfo info;
+        measure(options, "encode_key", parameters, [&] {
+            encoder.requestKeyframe();
+            ++info.sequence;
+            encoder.encode(frames[0].data(), output.data(), info);
+            keep(output.data());
+        });
+        int next = 0;
+        measure(options, "encode_delta", parameters, [&] {
+            ++info.sequence;
+            encoder.encode(frames[next].data(), output.data(), info);
+            keep(output.data());
+            next ^= 1;
+        });
+
+        // Alternating keyframe and delta messages keep the decoder in sync on every call
+        std::vector<std::vector<unsigned char>> messages;
+        encoder.requestKeyframe();
+        for (int i = 0; i < 2; ++i) {
+            ++info.sequence;
+            const size_t size = encoder.encode(frames[i].data(), output.data(), info);
+            messages.emplace_back(output.data(), output.data() + size);
+        }
+        FrameDecoder decoder;
+        measure(options, "decode", parameters, [&] {
+            decoder.decode(messages[0].data(), messages[0].size());
+            decoder.decode(messages[1].data(), messages[1].size());
+            keep(decoder.pixels());
+        });
+    }
+}
+
+static Options parseOptions(const int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t separator = arg.find('=');
+        const std::string option = arg.substr(0, separator);
+        const std::string value = separator == std::string::npos ? "" : arg.substr(separator + 1);
+        if (option == "--filter") {
+            options.filter = value;
+        } else if (option == "--min-time") {
+            options.minTimeMs = std::stoi(value);
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    return options;
+}
+
+// Prints one JSON object per kernel and size, diff two runs to spot regressions between versions
+int main(const int argc, char** argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        fprintf(stderr, "Usage: %s [--filter=KERNEL] [--min-time=MS]\n", argv[0]);
+        return 1;
+    }
+
+    benchmarkFFT(options);
+    benchmarkSampleKernels(options);
+    benchmarkBandKernels(options);
+    benchmarkCodec(options);
+    return 0;
+}
@@ -0,0 +1,188 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "codec.hpp"
+
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static bool samePixel(const unsigned char* a, const unsigned char* b) {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+size_t maxEncodedSize(const size_t pixelCount) {
+    return sizeof(WireHeader) + pixelCount * 3 + pixelCount / WIRE_RLE_MAX_RUN + 1;
+}
+
+size_t encodeRunLength(const unsigned char* pixels, const size_t pixelCount, unsigned char* output) {
+    size_t written = 0;
+    size_t i = 0;
+    while (i < pixelCount) {
+        const unsigned char* pixel = pixels + i * 3;
+        size_t run = 1;
+        if (pixel[0] == 0 && pixel[1] == 0 && pixel[2] == 0) {
+            // Unchanged areas of deltas are long zero runs, found 16 bytes at a time
+            run = zeroPrefix(pixel, (pixelCount - i) * 3) / 3;
+        } else {
+            while (i + run < pixelCount && run < WIRE_RLE_MAX_RUN && samePixel(pixel, pixel + run * 3)) ++run;
+        }
+
+        if (run >= 2) {
+            for (size_t remaining = run; remaining > 0;) {
+                const size_t token = std::min<size_t>(remaining, WIRE_RLE_MAX_RUN);
+                if (token == 1) {
+                    output[written++] = 0;
+                } else {
+                    output[written++] = static_cast<unsigned char>(0x80 | (token - 1));
+                }
+                std::memcpy(output + written, pixel, 3);
+                written += 3;
+                remaining -= token;
+            }
+            i += run;
+            continue;
+        }
+
+        // Literals until the next run of two or WIRE_RLE_MAX_RUN pixels
+        size_t literals = 1;
+        while (i + literals < pixelCount && literals < WIRE_RLE_MAX_RUN
+            && !(i + literals + 1 < pixelCount && samePixel(pixels + (i + literals) * 3, pixels + (i + literals + 1) * 3))) {
+            ++literals;
+        }
+        output[written++] = static_cast<unsigned char>(literals - 1);
+        std::memcpy(output + written, pixel, literals * 3);
+        written += literals * 3;
+        i += literals;
+    }
+    return written;
+}
+
+bool decodeRunLength(const unsigned char* input, const size_t size, unsigned char* pixels, const size_t pixelCount) {
+    size_t read = 0;
+    size_t decoded = 0;
+    while (read < size) {
+        const unsigned char control = input[read++];
+        const size_t count = (control & 0x7F) + 1;
+        if (decoded + count > pixelCount) return false;
+        if (control & 0x80) {
+            if (read + 3 > size) return false;
+            for (size_t j = 0; j < count; ++j) {
+                std::memcpy(pixels + (decoded + j) * 3, input + read, 3);
+            }
+            read += 3;
+        } else {
+            if (read + count * 3 > size) return false;
+            std::memcpy(pixels + decoded * 3, input + read, count * 3);
+            read += count * 3;
+        }
+        decoded += count;
+    }
+    return decoded == pixelCount;
+}
+
+void FrameEncoder::init(const int width, const int height) {
+    this->width = width;
+    this->height = height;
+    const size_t frameSize = static_cast<size_t>(width) * height * 3;
+    this->previous = nullptr;
+    this->delta.assign(frameSize, 0);
+    this->keyframeRequested = true;
+}
+
+size_t FrameEncoder::encode(const unsigned char* pixels, unsigned char* output, const WireFrameInfo& info) {
+    const size_t pixelCount = static_cast<size_t>(this->width) * this->height;
+    const size_t frameSize = pixelCount * 3;
+    const bool keyframe = this->keyframeRequested || this->previous == nullptr || this->framesSinceKeyframe + 1 >= WIRE_KEYFRAME_INTERVAL;
+
+    const unsigned char* source = pixels;
+    if (!keyframe) {
+        xorBytes(pixels, this->previous, this->delta.data(), frameSize);
+        source = this->delta.data();
+    }
+
+    WireHeader header;
+    header.type = keyframe ? WIRE_KEYFRAME : WIRE_DELTA;
+    header.width = static_cast<uint16_t>(this->width);
+    header.height = static_cast<uint16_t>(this->height);
+    header.sequence = info.sequence;
+    header.reference = keyframe ? info.sequence : this->sequence;
+    header.captureTime = info.captureTime;
+    header.renderTime = info.renderTime;
+
+    unsigned char* payload = output + sizeof(WireHeader);
+    size_t payloadSize = encodeRunLength(source, pixelCount, payload);
+    header.compression = WIRE_COMPRESSION_RLE;
+    if (payloadSize >= frameSize) {
+        // Noise does not compress, send it as is
+        std::memcpy(payload, source, frameSize);
+        payloadSize = frameSize;
+        header.compression = WIRE_COMPRESSION_NONE;
+    }
+    std::memcpy(output, &header, sizeof(header));
+
+    this->previous = pixels;
+    this->sequence = info.sequence;
+    this->framesSinceKeyframe = keyframe ? 0 : this->framesSinceKeyframe + 1;
+    this->keyframeRequested = false;
+    return sizeof(WireHeader) + payloadSize;
+}
+
+bool FrameDecoder::decode(const unsigned char* message, const size_t size) {
+    WireHeader header;
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, message, sizeof(header));
+    }
+    if (size < sizeof(header) || header.magic != WIRE_MAGIC) {
+        // Plain RGB from a sender that does not encode
+        this->frame.assign(message, message + size);
+        this->frameInfo = WireFrameInfo{};
+        return true;
+    }
+    if (header.version != WIRE_VERSION || header.format != WIRE_FORMAT_RGB24) return false;
+    if ((header.type != WIRE_KEYFRAME && header.type != WIRE_DELTA) || header.width == 0 || header.height == 0) return false;
+
+    const size_t pixelCount = static_cast<size_t>(header.width) * header.height;
+    const unsigned char* payload = message + sizeof(header);
+    const size_t payloadSize = size - sizeof(header);
+    // The payload has to be able to hold the frame before anything is sized after the header.
+    // Every RLE token covers at most WIRE_RLE_MAX_RUN pixels in at least 4 bytes.
+    if (header.compression == WIRE_COMPRESSION_NONE) {
+        if (payloadSize != pixelCount * 3) return false;
+    } else if (header.compression == WIRE_COMPRESSION_RLE) {
+        const size_t tokens = (pixelCount + WIRE_RLE_MAX_RUN - 1) / WIRE_RLE_MAX_RUN;
+        if (payloadSize < tokens * 4 || payloadSize > maxEncodedSize(pixelCount) - sizeof(WireHeader)) return false;
+    } else {
+        return false;
+    }
+
+    if (header.type == WIRE_DELTA && (this->keyframeNeeded || header.reference != this->sequence || this->frame.size() != pixelCount * 3)) {
+        this->keyframeNeeded = true;
+        return false;
+    }
+    if (header.type == WIRE_KEYFRAME) {
+        this->frame.resize(pixelCount * 3);
+    }
+
+    // Deltas are decoded into a scratch frame and XORed in, a keyframe replaces the frame directly
+    unsigned char* target = this->frame.data();
+    if (header.type == WIRE_DELTA) {
+        this->decoded.resize(pixelCount * 3);
+        target = this->decoded.data();
+    }
+    if (header.compression == WIRE_COMPRESSION_NONE) {
+        std::memcpy(target, payload, payloadSize);
+    } else if (!decodeRunLength(payload, payloadSize, target, pixelCount)) {
+        this->keyframeNeeded = true;
+        return false;
+    }
+    if (header.type == WIRE_DELTA) {
+        xorBytes(this->frame.data(), this->decoded.data(), this->frame.data(), pixelCount * 3);
+    }
+    this->sequence = header.sequence;
+    this->frameInfo = WireFrameInfo{header.sequence, header.captureTime, header.renderTime};
+    this->keyframeNeeded = false;
+    return true;
+}
@@ -0,0 +1,105 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#define WIRE_MAGIC 0x31534956 // "VIS1"
+#define WIRE_VERSION 2
+#define WIRE_KEYFRAME 0
+#define WIRE_DELTA 1
+#define WIRE_COMPRESSION_NONE 0
+// Runs of identical RGB pixels, see FrameEncoder
+#define WIRE_COMPRESSION_RLE 1
+#define WIRE_FORMAT_RGB24 0
+// A keyframe at least this often, so a receiver that missed one recovers without asking
+#define WIRE_KEYFRAME_INTERVAL 120
+#define WIRE_RLE_MAX_RUN 128
+
+// Flags of the one byte reply of a receiver that understands the format, a legacy receiver replies empty
+#define WIRE_REPLY_ENCODED 1
+#define WIRE_REPLY_KEYFRAME 2
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Little endian on the wire, like every host we run on
+struct __attribute__((packed)) WireHeader {
+    uint32_t magic = WIRE_MAGIC;
+    uint8_t version = WIRE_VERSION;
+    uint8_t type = WIRE_KEYFRAME;
+    uint8_t compression = WIRE_COMPRESSION_NONE;
+    uint8_t format = WIRE_FORMAT_RGB24;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    // Counts every frame the sender meant to send, a gap is a frame dropped on the way
+    uint32_t sequence = 0;
+    // Sequence of the frame a delta applies to
+    uint32_t reference = 0;
+    // Wall clock nanoseconds of the audio capture the frame shows and of render start, 0 when unknown.
+    // One-way latency across machines is only as good as their clock sync.
+    int64_t captureTime = 0;
+    int64_t renderTime = 0;
+};
+
+// What the header says about a frame besides its pixels
+struct WireFrameInfo {
+    uint32_t sequence = 0;
+    int64_t captureTime = 0;
+    int64_t renderTime = 0;
+};
+
+// Encodes RGB frames as keyframes or as the XOR against the previous frame, either one run-length coded.
+// RLE tokens: a control byte c < 128 is followed by c+1 literal pixels, c >= 128 by one pixel repeated (c&127)+1 times.
+// Unchanged areas of a delta are zero runs and cost 4 bytes per WIRE_RLE_MAX_RUN pixels.
+class FrameEncoder {
+    int width = 0;
+    int height = 0;
+    // Sequence of the frame previous points at, the reference of the next delta
+    uint32_t sequence = 0;
+    int framesSinceKeyframe = 0;
+    bool keyframeRequested = true;
+    // The caller's pixels of the last call, deltas are taken against them instead of a copy
+    const unsigned char* previous = nullptr;
+    std::vector<unsigned char> delta;
+public:
+    // Allocates all buffers, encode() does not allocate
+    void init(int width, int height);
+    // Encodes width*height*3 bytes of pixels into output, which holds maxEncodedSize(width*height) bytes.
+    // pixels must stay untouched until the next call.
+    size_t encode(const unsigned char* pixels, unsigned char* output, const WireFrameInfo& info);
+    void requestKeyframe() { this->keyframeRequested = true; }
+
+    bool lastWasKeyframe() const { return this->framesSinceKeyframe == 0; }
+};
+
+// Reference decoder for receivers. Accepts encoded messages as well as plain RGB frames from senders that do not encode.
+class FrameDecoder {
+    std::vector<unsigned char> frame;
+    std::vector<unsigned char> decoded;
+    uint32_t sequence = 0;
+    bool keyframeNeeded = true;
+    WireFrameInfo frameInfo;
+public:
+    // Returns false and asks for a keyframe when the message cannot be applied to the current frame
+    bool decode(const unsigned char* message, size_t size);
+
+    const unsigned char* pixels() const { return this->frame.data(); }
+    size_t size() const { return this->frame.size(); }
+    // Header of the current frame, all 0 for plain RGB
+    const WireFrameInfo& info() const { return this->frameInfo; }
+    bool needsKeyframe() const { return this->keyframeNeeded; }
+};
+
+// Largest encoded message for a frame of pixelCount pixels
+size_t maxEncodedSize(size_t pixelCount);
+// Returns the bytes written to output, which must hold pixelCount*3 + pixelCount/WIRE_RLE_MAX_RUN + 1 bytes
+size_t encodeRunLength(const unsigned char* pixels, size_t pixelCount, unsigned char* output);
+// Returns false on malformed input or when the runs do not add up to pixelCount
+bool decodeRunLength(const unsigned char* input, size_t size, unsigned char* pixels, size_t pixelCount);
+
+
+
+#endif //CODEC_HPP
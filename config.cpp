@@ -0,0 +1,126 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "config.hpp"
+
+#include "output.hpp"
+#include "sink.hpp"
+#include "udp.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+int parseInt(const std::string& option, const std::string& value) {
+    try {
+        size_t end;
+        const int result = std::stoi(value, &end);
+        if (end == value.size()) return result;
+    } catch (const std::logic_error&) {}
+    throw std::runtime_error("Invalid value for " + option + ": " + value);
+}
+
+Config parseConfig(const int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t separator = arg.find('=');
+        const std::string option = arg.substr(0, separator);
+        const std::string value = separator == std::string::npos ? "" : arg.substr(separator + 1);
+
+        if (option == "--source") {
+            if (value != "portaudio" && value != "synthetic" && value != "clicks") {
+                throw std::runtime_error("Unknown source: " + value);
+            }
+            config.source = value;
+        } else if (option == "--endpoint") {
+            config.endpoint = value;
+        } else if (option == "--fps") {
+            config.fps = parseInt(option, value);
+            if (config.fps < 0) {
+                throw std::runtime_error("Invalid value for --fps: " + value);
+            }
+        } else if (option == "--wire") {
+            if (value != "auto" && value != "raw") {
+                throw std::runtime_error("Unknown wire format: " + value);
+            }
+            config.wire = value;
+        } else if (option == "--output") {
+            if (!isOutputUrl(value)) {
+                throw std::runtime_error("Unknown output: " + value);
+            }
+            config.outputs.push_back(value);
+        } else if (option == "--udp-pace") {
+            config.udpPaceUs = parseInt(option, value);
+        } else if (option == "--keepalive") {
+            config.keepaliveMs = parseInt(option, value);
+        } else if (option == "--idle-fps") {
+            config.idleFps = parseInt(option, value);
+            if (config.idleFps < 0) {
+                throw std::runtime_error("Invalid value for --idle-fps: " + value);
+            }
+        } else if (option == "--silence-threshold") {
+            config.silenceThresholdDb = parseInt(option, value);
+        } else if (option == "--metrics") {
+            config.metrics = value;
+        } else if (option == "--trace") {
+            config.trace = value;
+        } else if (option == "--alloc-check") {
+            config.allocCheckSeconds = parseInt(option, value);
+        } else if (option == "--latency-test") {
+            config.latencyClicks = parseInt(option, value);
+        } else if (option == "--latency-budget") {
+            config.latencyBudgetMs = parseInt(option, value);
+        } else if (option == "--latency-offset") {
+            config.latencyOffsetMs = parseInt(option, value);
+        } else if (option == "--output-latency") {
+            config.outputLatencyMs = parseInt(option, value);
+        } else if (option == "--realtime") {
+            config.realtime = true;
+        } else if (option == "--rt-priority") {
+            config.realtimePriority = parseInt(option, value);
+        } else if (option == "--audio-cpu") {
+            config.audioCpu = parseInt(option, value);
+        } else if (option == "--render-cpu") {
+            config.renderCpu = parseInt(option, value);
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    return config;
+}
+
+void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --source=NAME       Audio source, portaudio (default), synthetic or clicks\n");
+    printf("  --endpoint=URL      ZeroMQ endpoint of the matrix (default tcp://matrix.kwsnet:5555), none disables it\n");
+    printf("  --output=URL        Also send to another sink, may be repeated: tcp://, ipc:// or inproc:// ZeroMQ endpoints\n");
+    printf("                      [?wire=auto|raw], ddp://HOST[:PORT], sacn://[HOST][:PORT][?universe=N] (multicast without host),\n");
+    printf("                      artnet://HOST[:PORT][?universe=N], wled://HOST[:PORT][?timeout=S], opc://HOST[:PORT][?channel=N] (TCP),\n");
+    printf("                      serial://DEVICE[?baud=N&protocol=adalight|tpm2] (capped to what the baud rate carries),\n");
+    printf("                      file://PATH (raw RGB), shm://NAME[?slots=N] (frame ring for a driver on this machine, see shmreader);\n");
+    printf("                      every sink takes start=PIXEL&count=PIXELS for part of the canvas,\n");
+    printf("                      fps=N to cap its rate and queue=N (default %d, max %d) frames it buffers before dropping\n",
+        SINK_DEFAULT_QUEUE, SINK_MAX_QUEUE);
+    printf("  --udp-pace=US       Pause between batches of %d UDP packets, for controllers with small buffers (default 0)\n", UDP_BATCH_PACKETS);
+    printf("  --fps=N             Target frame rate, 0 renders as fast as the slowest sink takes frames (default 60)\n");
+    printf("  --wire=FORMAT       auto (default) sends delta/RLE encoded frames when the receiver supports them, raw never does\n");
+    printf("  --keepalive=MS      Resend an unchanged frame after MS milliseconds, 0 sends every frame (default 1000)\n");
+    printf("  --idle-fps=N        Frame rate while the input is silent, 0 keeps the full rate (default 5)\n");
+    printf("  --silence-threshold=DB Peak level in dBFS below which input counts as silence (default -60)\n");
+    printf("  --metrics=TARGET    Export per-stage timing histograms in Prometheus format,\n");
+    printf("                      unix:PATH serves them on a Unix socket, anything else is a file rewritten every second\n");
+    printf("  --trace=PATH        Record a Chrome trace (chrome://tracing, Perfetto) of every stage,\n");
+    printf("                      written to PATH on SIGUSR1 and at exit\n");
+    printf("  --alloc-check=N     Run on the synthetic source against a local receiver and fail\n");
+    printf("                      if the real-time threads allocate within N seconds after warm-up\n");
+    printf("  --latency-test=N    Inject N clicks and measure capture to receiver latency headless\n");
+    printf("  --latency-budget=MS Fail the latency test if the p99 exceeds MS milliseconds\n");
+    printf("  --latency-offset=MS Fixed delay from capture to light, hides pipeline jitter (default 0, newest frame)\n");
+    printf("  --output-latency=MS Expected time from render start until the frame lights up (default 0)\n");
+    printf("  --realtime          SCHED_FIFO audio thread, mlockall and pre-faulted buffers\n");
+    printf("  --rt-priority=N     SCHED_FIFO priority of the audio thread (default 70)\n");
+    printf("  --audio-cpu=N       Pin the audio capture/analysis thread to CPU N\n");
+    printf("  --render-cpu=N      Pin the render thread to CPU N\n");
+}
@@ -0,0 +1,44 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <string>
+#include <vector>
+
+struct Config {
+    std::string source = "portaudio";
+    std::string endpoint = "tcp://matrix.kwsnet:5555";
+    int fps = 60;
+    std::string wire = "auto";
+    // Sink URLs fed next to the ZMQ endpoint, see createSinks()
+    std::vector<std::string> outputs;
+    int udpPaceUs = 0;
+    int keepaliveMs = 1000;
+    int idleFps = 5;
+    int silenceThresholdDb = -60;
+    std::string metrics;
+    std::string trace;
+    int allocCheckSeconds = 0;
+    int latencyClicks = 0;
+    int latencyBudgetMs = 0;
+    int latencyOffsetMs = 0;
+    int outputLatencyMs = 0;
+
+    bool realtime = false;
+    int realtimePriority = 70;
+    int audioCpu = -1;
+    int renderCpu = -1;
+};
+
+// Parses --key=value style command line options, throws on unknown options
+Config parseConfig(int argc, char** argv);
+void printUsage(const char* program);
+// The whole of value as a number, throws naming option otherwise
+int parseInt(const std::string& option, const std::string& value);
+
+
+
+#endif //CONFIG_HPP
@@ -0,0 +1,37 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "fft.hpp"
+
+void BatchedFFT::allocate(const int size, const int maxChannels) {
+    this->size = size;
+    this->maxChannels = maxChannels;
+    this->input = static_cast<float *>(fftwf_malloc(this->inputBytes()));
+    this->output = static_cast<fftwf_complex *>(fftwf_malloc(this->outputBytes()));
+}
+
+void BatchedFFT::plan(const int channels, const unsigned flags) {
+    if (this->fftPlan != nullptr) {
+        fftwf_destroy_plan(this->fftPlan);
+    }
+    this->fftPlan = fftwf_plan_many_dft_r2c(1, &this->size, channels,
+        this->input, nullptr, 1, this->size,
+        this->output, nullptr, 1, this->bins(),
+        flags);
+}
+
+void BatchedFFT::execute() const {
+    fftwf_execute(this->fftPlan);
+}
+
+void BatchedFFT::destroy() {
+    if (this->fftPlan != nullptr) {
+        fftwf_destroy_plan(this->fftPlan);
+        this->fftPlan = nullptr;
+    }
+    fftwf_free(this->output);
+    fftwf_free(this->input);
+    this->output = nullptr;
+    this->input = nullptr;
+}
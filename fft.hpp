@@ -0,0 +1,36 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <fftw3.h>
+#include <cstddef>
+
+// Real-to-complex FFT of several channels at once: one batched FFTW plan over a planar input buffer.
+// Buffers are sized for maxChannels up front so plan() can follow once the channel count is known.
+class BatchedFFT {
+    int size = 0;
+    int maxChannels = 0;
+    float* input = nullptr;
+    fftwf_complex* output = nullptr;
+    fftwf_plan fftPlan = nullptr;
+public:
+    void allocate(int size, int maxChannels);
+    void plan(int channels, unsigned flags);
+    void execute() const;
+    void destroy();
+
+    int bins() const { return this->size / 2 + 1; }
+    size_t inputBytes() const { return sizeof(float) * this->size * this->maxChannels; }
+    size_t outputBytes() const { return sizeof(fftwf_complex) * this->bins() * this->maxChannels; }
+    // Channel after channel, size samples each
+    float* planar() const { return this->input; }
+    // Channel after channel, bins() values each
+    fftwf_complex* spectrum() const { return this->output; }
+};
+
+
+
+#endif //FFT_HPP
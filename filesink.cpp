@@ -0,0 +1,43 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "filesink.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+bool isFileTarget(const std::string& url) {
+    return url.starts_with("file://");
+}
+
+void FileSink::configure(const OutputUrl& parsed, int, int) {
+    this->path = parsed.address;
+    if (this->path.empty()) {
+        throw std::runtime_error("Missing path in " + this->url);
+    }
+    if (!parsed.parameters.empty()) {
+        throw std::runtime_error("Unknown parameter " + parsed.parameters.front().first + " in " + this->url);
+    }
+    // Non-blocking like the devices, a reader that stops reading then only stalls this sink until it stops
+    this->descriptor = ::open(this->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK | O_CLOEXEC, 0644);
+    if (this->descriptor < 0) {
+        throw std::runtime_error("Cannot open " + this->path + ": " + strerror(errno));
+    }
+}
+
+bool FileSink::send(FrameBuffer* frame) {
+    iovec part{frame->data.get() + this->firstPixel * 3, this->pixelCount * 3};
+    return this->writeFully(this->descriptor, &part, 1, false);
+}
+
+void FileSink::close() {
+    if (this->descriptor >= 0) {
+        ::close(this->descriptor);
+        this->descriptor = -1;
+    }
+}
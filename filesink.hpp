@@ -0,0 +1,28 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef FILESINK_HPP
+#define FILESINK_HPP
+
+#include <string>
+
+#include "sink.hpp"
+
+bool isFileTarget(const std::string& url);
+
+// Appends the pixel range of every frame as raw RGB to a file or a named pipe, for recording
+// (ffmpeg -f rawvideo) or for local consumers. A pipe needs its reader before the visualizer starts.
+class FileSink : public Sink {
+    std::string path;
+    int descriptor = -1;
+protected:
+    // file://PATH, opens and truncates it
+    void configure(const OutputUrl& parsed, int width, int height) override;
+    bool send(FrameBuffer* frame) override;
+    void close() override;
+};
+
+
+
+#endif //FILESINK_HPP
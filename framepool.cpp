@@ -0,0 +1,39 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "framepool.hpp"
+
+#include <cstring>
+
+void FramePool::init(const int count, const size_t capacity) {
+    this->buffers = std::make_unique<FrameBuffer[]>(count);
+    this->count = count;
+    for (int i = 0; i < count; ++i) {
+        this->buffers[i].data = std::make_unique<unsigned char[]>(capacity);
+        this->buffers[i].capacity = capacity;
+        // Fault the pages in now instead of on the first readback
+        std::memset(this->buffers[i].data.get(), 0, capacity);
+    }
+}
+
+FrameBuffer* FramePool::acquire() {
+    // Round robin, so a buffer just released by the I/O thread is the last one to be reused
+    for (int i = 0; i < this->count; ++i) {
+        FrameBuffer& buffer = this->buffers[(this->next + i) % this->count];
+        int expected = 0;
+        if (buffer.references.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+            this->next = (this->next + i + 1) % this->count;
+            return &buffer;
+        }
+    }
+    return nullptr;
+}
+
+int FramePool::available() const {
+    int available = 0;
+    for (int i = 0; i < this->count; ++i) {
+        if (this->buffers[i].references.load(std::memory_order_relaxed) == 0) ++available;
+    }
+    return available;
+}
@@ -0,0 +1,49 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef FRAMEPOOL_HPP
+#define FRAMEPOOL_HPP
+
+// The frame being rendered, the previous one unchanged frames are compared against and a spare,
+// every sink adds what it can hold (Sink::buffers())
+#define FRAME_POOL_BUFFERS 3
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class FramePool;
+
+// A pooled buffer that goes back to its pool when the last reference is released.
+// Releasing is lock-free, so it may happen on any sink's thread.
+struct FrameBuffer {
+    std::unique_ptr<unsigned char[]> data;
+    size_t capacity = 0;
+    std::atomic<int> references = 0;
+    // steady_clock nanoseconds of the audio capture the pixels show (0 when unknown) and of render start,
+    // set by the render thread before the frame goes to the sinks
+    int64_t captureTime = 0;
+    int64_t renderTime = 0;
+
+    void retain() { this->references.fetch_add(1, std::memory_order_relaxed); }
+    void release() { this->references.fetch_sub(1, std::memory_order_release); }
+};
+
+// Fixed set of frame buffers allocated up front, acquire() never allocates
+class FramePool {
+    std::unique_ptr<FrameBuffer[]> buffers;
+    int count = 0;
+    int next = 0;
+public:
+    void init(int count, size_t capacity);
+
+    // A free buffer holding one reference for the caller, nullptr when all of them are still referenced
+    FrameBuffer* acquire();
+    int available() const;
+};
+
+
+
+#endif //FRAMEPOOL_HPP
@@ -0,0 +1,271 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio.hpp"
+#include "colorcli.hpp"
+#include "renderer.hpp"
+#include "timing.hpp"
+
+#define GOLDEN_WIDTH 128
+#define GOLDEN_HEIGHT 32
+#define GOLDEN_FRAMES 64
+// Lets the AGC settle and the synthetic sweep leave the lowest octave before recording starts
+#define GOLDEN_WARMUP_FRAMES 375
+#define GOLDEN_MAGIC 0x46534956 // "VISF"
+#define GOLDEN_VERSION 1
+// A pixel differs when any channel is off by more than this, drivers round differently
+#define GOLDEN_TOLERANCE 8
+// Share of differing pixels an image may have and still match
+#define GOLDEN_MISMATCH_FRACTION 0.005
+
+struct Options {
+    std::string shaders = "shaders";
+    std::string golden = "golden";
+    bool record = false;
+    bool update = false;
+    int tolerance = GOLDEN_TOLERANCE;
+};
+
+struct RecordingHeader {
+    uint32_t magic = GOLDEN_MAGIC;
+    uint32_t version = GOLDEN_VERSION;
+    uint32_t frames = 0;
+    uint32_t channels = 0;
+};
+
+// Only the channels in use are stored, the rest of each frame stays zero
+static void writeFrame(std::ofstream& file, const AnalysisFrame& frame) {
+    file.write(reinterpret_cast<const char*>(&frame.amplitude), sizeof(frame.amplitude));
+    file.write(reinterpret_cast<const char*>(frame.spectrum), frame.channels * FFW_BANDS * sizeof(fftwf_complex));
+    file.write(reinterpret_cast<const char*>(frame.bands), frame.channels * LOG_BANDS * sizeof(float));
+    file.write(reinterpret_cast<const char*>(frame.stereo), sizeof(frame.stereo));
+    file.write(reinterpret_cast<const char*>(frame.waveform), sizeof(frame.waveform));
+}
+
+static void readFrame(std::ifstream& file, AnalysisFrame& frame) {
+    file.read(reinterpret_cast<char*>(&frame.amplitude), sizeof(frame.amplitude));
+    file.read(reinterpret_cast<char*>(frame.spectrum), frame.channels * FFW_BANDS * sizeof(fftwf_complex));
+    file.read(reinterpret_cast<char*>(frame.bands), frame.channels * LOG_BANDS * sizeof(float));
+    file.read(reinterpret_cast<char*>(frame.stereo), sizeof(frame.stereo));
+    file.read(reinterpret_cast<char*>(frame.waveform), sizeof(frame.waveform));
+}
+
+// Runs the synthetic source through the real analysis and stores GOLDEN_FRAMES consecutive frames
+static void record(const std::string& path) {
+    Audio audio;
+    audio.init(std::make_unique<SyntheticSource>());
+    std::thread audioThread([&audio] { audio.start(); });
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+    RecordingHeader header;
+    header.frames = GOLDEN_FRAMES;
+    bool headerWritten = false;
+
+    uint64_t next = GOLDEN_WARMUP_FRAMES;
+    while (next < GOLDEN_WARMUP_FRAMES + GOLDEN_FRAMES) {
+        uint64_t newest = 0;
+        if (audio.frameAt(INT64_MAX, newest) == nullptr || newest < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        for (; next <= newest && next < GOLDEN_WARMUP_FRAMES + GOLDEN_FRAMES; ++next) {
+            const AnalysisFrame& frame = audio.frame(next);
+            if (!headerWritten) {
+                header.channels = frame.channels;
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                headerWritten = true;
+            }
+            writeFrame(file, frame);
+        }
+    }
+    audio.running = false;
+    audioThread.join();
+    printf("Recorded %s%d%s frames to %s\n", CLI_GREEN, GOLDEN_FRAMES, CLI_RESET, path.c_str());
+}
+
+static std::vector<AnalysisFrame> load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    RecordingHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != GOLDEN_MAGIC || header.version != GOLDEN_VERSION || header.channels < 1 || header.channels > MAX_CHANNELS) {
+        throw std::runtime_error("Not a recording: " + path + ", create one with --record");
+    }
+    std::vector<AnalysisFrame> frames(header.frames);
+    for (AnalysisFrame& frame : frames) {
+        frame.channels = static_cast<int>(header.channels);
+        readFrame(file, frame);
+    }
+    if (!file) {
+        throw std::runtime_error("Truncated recording: " + path);
+    }
+    return frames;
+}
+
+static void writeImage(const std::string& path, const std::vector<unsigned char>& pixels) {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << GOLDEN_WIDTH << " " << GOLDEN_HEIGHT << "\n255\n";
+    // GL rows start at the bottom
+    for (int row = GOLDEN_HEIGHT - 1; row >= 0; --row) {
+        file.write(reinterpret_cast<const char*>(&pixels[row * GOLDEN_WIDTH * 3]), GOLDEN_WIDTH * 3);
+    }
+}
+
+static bool readImage(const std::string& path, std::vector<unsigned char>& pixels) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int width = 0, height = 0, maxValue = 0;
+    file >> magic >> width >> height >> maxValue;
+    file.get();
+    if (!file || magic != "P6" || width != GOLDEN_WIDTH || height != GOLDEN_HEIGHT || maxValue != 255) return false;
+    pixels.resize(GOLDEN_WIDTH * GOLDEN_HEIGHT * 3);
+    for (int row = GOLDEN_HEIGHT - 1; row >= 0; --row) {
+        file.read(reinterpret_cast<char*>(&pixels[row * GOLDEN_WIDTH * 3]), GOLDEN_WIDTH * 3);
+    }
+    return static_cast<bool>(file);
+}
+
+static int countMismatches(const std::vector<unsigned char>& actual, const std::vector<unsigned char>& expected, const int tolerance) {
+    int mismatches = 0;
+    for (size_t i = 0; i < actual.size(); i += 3) {
+        for (int channel = 0; channel < 3; ++channel) {
+            if (std::abs(actual[i + channel] - expected[i + channel]) > tolerance) {
+                ++mismatches;
+                break;
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Renders every recorded frame through shader, compares the snapshots and returns whether all of them matched
+static bool check(const Options& options, const std::filesystem::path& shader, const std::vector<AnalysisFrame>& frames) {
+    const std::string name = shader.stem().string();
+    Renderer renderer;
+    renderer.frames = [&frames](const uint64_t index) -> const AnalysisFrame& {
+        return frames[index];
+    };
+    renderer.oldestFrame = [] {
+        return uint64_t{0};
+    };
+    renderer.init(GOLDEN_WIDTH, GOLDEN_HEIGHT, options.shaders + "/shader.vert", shader.string());
+
+    const uint64_t snapshots[] = {frames.size() / 2, frames.size() - 1};
+    const float blockMilliseconds = 1000.0f * FRAMES_PER_BUFFER / 48000;
+    std::vector<unsigned char> pixels(GOLDEN_WIDTH * GOLDEN_HEIGHT * 3);
+    std::vector<double> renderTimes;
+    bool matched = true;
+    int worstMismatches = 0;
+
+    for (uint64_t index = 0; index < frames.size(); ++index) {
+        const int64_t start = steadyNanoseconds();
+        renderer.upload(frames[index], index);
+        renderer.draw(static_cast<float>(index) * blockMilliseconds);
+        renderer.readback(pixels.data());
+        renderTimes.push_back(static_cast<double>(steadyNanoseconds() - start) / 1e6);
+
+        if (std::find(std::begin(snapshots), std::end(snapshots), index) == std::end(snapshots)) continue;
+        const std::string goldenPath = options.golden + "/" + name + "-" + std::to_string(index) + ".ppm";
+        if (options.update) {
+            writeImage(goldenPath, pixels);
+            continue;
+        }
+        std::vector<unsigned char> expected;
+        if (!readImage(goldenPath, expected)) {
+            printf("%sMissing golden image %s, create it with --update%s\n", CLI_RED, goldenPath.c_str(), CLI_RESET);
+            matched = false;
+            continue;
+        }
+        const int mismatches = countMismatches(pixels, expected, options.tolerance);
+        worstMismatches = std::max(worstMismatches, mismatches);
+        if (mismatches > GOLDEN_MISMATCH_FRACTION * GOLDEN_WIDTH * GOLDEN_HEIGHT) {
+            const std::string actualPath = options.golden + "/" + name + "-" + std::to_string(index) + ".actual.ppm";
+            writeImage(actualPath, pixels);
+            printf("%s%s differs from %s in %d pixels, wrote %s%s\n", CLI_RED, name.c_str(), goldenPath.c_str(), mismatches, actualPath.c_str(), CLI_RESET);
+            matched = false;
+        }
+    }
+    renderer.destroy();
+
+    // The first frames include shader compilation and upload of empty history
+    std::sort(renderTimes.begin() + 1, renderTimes.end());
+    const double median = renderTimes[1 + (renderTimes.size() - 1) / 2];
+    const char* status = options.update ? "updated" : matched ? "ok" : "FAILED";
+    printf("%s%-20s%s %s%-8s%s %4d px off  render %.3f ms/frame\n", CLI_BLUE, name.c_str(), CLI_RESET,
+        matched ? CLI_GREEN : CLI_RED, status, CLI_RESET, worstMismatches, median);
+    return matched;
+}
+
+static Options parseOptions(const int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t separator = arg.find('=');
+        const std::string option = arg.substr(0, separator);
+        const std::string value = separator == std::string::npos ? "" : arg.substr(separator + 1);
+        if (option == "--shaders") {
+            options.shaders = value;
+        } else if (option == "--golden") {
+            options.golden = value;
+        } else if (option == "--record") {
+            options.record = true;
+        } else if (option == "--update") {
+            options.update = true;
+        } else if (option == "--tolerance") {
+            options.tolerance = std::stoi(value);
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    return options;
+}
+
+// Renders every shader over recorded analysis frames and compares against golden images.
+// Runs on Mesa's software rasterizer without a GPU (LIBGL_ALWAYS_SOFTWARE=1 forces it where a GPU exists).
+int main(const int argc, char** argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        fprintf(stderr, "Usage: %s [--shaders=DIR] [--golden=DIR] [--tolerance=N] [--update] [--record]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string recording = options.golden + "/frames.bin";
+    if (options.record) {
+        record(recording);
+        return 0;
+    }
+    const std::vector<AnalysisFrame> frames = load(recording);
+
+    std::vector<std::filesystem::path> shaders;
+    for (const auto& entry : std::filesystem::directory_iterator(options.shaders)) {
+        if (entry.path().extension() == ".frag") shaders.push_back(entry.path());
+    }
+    std::sort(shaders.begin(), shaders.end());
+
+    int failed = 0;
+    for (const auto& shader : shaders) {
+        if (!check(options, shader, frames)) ++failed;
+    }
+    if (failed > 0) {
+        printf("%s%d of %zu shaders differ from their golden images%s\n", CLI_RED, failed, shaders.size(), CLI_RESET);
+        return 1;
+    }
+    return 0;
+}
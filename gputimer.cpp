@@ -0,0 +1,78 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "gputimer.hpp"
+
+#include "alloctrack.hpp"
+#include "colorcli.hpp"
+
+#include <glad/gl.h>
+
+#include <cstdio>
+
+void GpuTimers::init() {
+    this->available = GLAD_GL_VERSION_3_3 != 0;
+    if (!this->available) {
+        printf("%sTimer queries not supported, GPU stage timings are disabled%s\n", CLI_YELLOW, CLI_RESET);
+        return;
+    }
+    glGenQueries(GPU_TIMER_FRAMES * GPU_TIMER_STAGES, &this->queries[0][0]);
+}
+
+void GpuTimers::destroy() {
+    if (!this->available) return;
+    glDeleteQueries(GPU_TIMER_FRAMES * GPU_TIMER_STAGES, &this->queries[0][0]);
+}
+
+void GpuTimers::collect(const int slot, const bool discard) {
+    for (int stage = 0; stage < GPU_TIMER_STAGES; ++stage) {
+        if (!this->pending[slot][stage]) continue;
+        GLint ready = GL_FALSE;
+        {
+            DriverScope driver;
+            glGetQueryObjectiv(this->queries[slot][stage], GL_QUERY_RESULT_AVAILABLE, &ready);
+        }
+        if (!ready) {
+            // Still running after GPU_TIMER_FRAMES, the slot is reused and this sample is lost rather than waited for
+            if (discard) this->pending[slot][stage] = false;
+            continue;
+        }
+        GLuint64 elapsed = 0;
+        {
+            DriverScope driver;
+            glGetQueryObjectui64v(this->queries[slot][stage], GL_QUERY_RESULT, &elapsed);
+        }
+        // Some drivers (llvmpipe) report nonsense for queries issued before the first frame completed
+        const Stage timed = static_cast<Stage>(static_cast<int>(Stage::GpuUpload) + stage);
+        if (this->frame > GPU_TIMER_WARMUP_FRAMES) {
+            stageHistogram(timed).record(static_cast<int64_t>(elapsed));
+        }
+        this->pending[slot][stage] = false;
+    }
+}
+
+void GpuTimers::beginFrame() {
+    if (!this->available) return;
+    ++this->frame;
+    for (int slot = 0; slot < GPU_TIMER_FRAMES; ++slot) {
+        this->collect(slot, slot == static_cast<int>(this->frame % GPU_TIMER_FRAMES));
+    }
+}
+
+void GpuTimers::begin(const Stage stage) {
+    if (!this->available) return;
+    this->active = static_cast<int>(stage) - static_cast<int>(Stage::GpuUpload);
+    DriverScope driver;
+    glBeginQuery(GL_TIME_ELAPSED, this->queries[this->frame % GPU_TIMER_FRAMES][this->active]);
+}
+
+void GpuTimers::end() {
+    if (!this->available || this->active < 0) return;
+    {
+        DriverScope driver;
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    this->pending[this->frame % GPU_TIMER_FRAMES][this->active] = true;
+    this->active = -1;
+}
@@ -0,0 +1,40 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef GPUTIMER_HPP
+#define GPUTIMER_HPP
+
+// Results are read this many frames after they were issued, by then the GPU is done and reading does not stall
+#define GPU_TIMER_FRAMES 4
+#define GPU_TIMER_STAGES 3
+#define GPU_TIMER_WARMUP_FRAMES (2*GPU_TIMER_FRAMES)
+
+#include <cstdint>
+
+#include "metrics.hpp"
+
+// GL_TIME_ELAPSED query rings around the GPU side of upload, draw and readback.
+// Finished queries are collected at the start of a frame and recorded into the Stage::Gpu* histograms.
+class GpuTimers {
+    unsigned int queries[GPU_TIMER_FRAMES][GPU_TIMER_STAGES] = {};
+    bool pending[GPU_TIMER_FRAMES][GPU_TIMER_STAGES] = {};
+    uint64_t frame = 0;
+    int active = -1;
+    bool available = false;
+
+    void collect(int slot, bool discard);
+public:
+    // Needs a current context with timer queries (GL 3.3), otherwise all calls are no-ops
+    void init();
+    void destroy();
+
+    void beginFrame();
+    // stage is one of Stage::GpuUpload, Stage::GpuDraw or Stage::GpuReadback, queries cannot nest
+    void begin(Stage stage);
+    void end();
+};
+
+
+
+#endif //GPUTIMER_HPP
@@ -0,0 +1,69 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "latency.hpp"
+
+#include "colorcli.hpp"
+#include "timing.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+void LatencyProbe::frameReceived(const unsigned char* pixels, const size_t size, const WireFrameInfo& info) {
+    const int64_t received = steadyNanoseconds();
+    // The header's timestamps are on the wall clock
+    const int64_t receivedWall = wallNanoseconds();
+
+    size_t litPixels = 0;
+    for (size_t i = 0; i + 2 < size; i += 3) {
+        if (std::max({pixels[i], pixels[i+1], pixels[i+2]}) >= LATENCY_LIT_LEVEL) ++litPixels;
+    }
+    const bool nowLit = static_cast<double>(litPixels) >= LATENCY_LIT_FRACTION * static_cast<double>(size / 3);
+    const bool rising = nowLit && !this->lit;
+    this->lit = nowLit;
+    if (!rising) return;
+
+    const int64_t click = this->source.lastClickTime;
+    if (click == 0 || click == this->matchedClick) return;
+    this->matchedClick = click;
+
+    std::lock_guard lock(this->mutex);
+    this->endToEnd.push_back(static_cast<double>(received - click) / 1e6);
+    // Raw frames carry no header, they only count end to end
+    if (info.renderTime != 0) {
+        if (info.captureTime != 0) {
+            this->captureToRender.push_back(static_cast<double>(info.renderTime - info.captureTime) / 1e6);
+        }
+        this->renderToReceive.push_back(static_cast<double>(receivedWall - info.renderTime) / 1e6);
+    }
+}
+
+size_t LatencyProbe::samples() {
+    std::lock_guard lock(this->mutex);
+    return this->endToEnd.size();
+}
+
+static double percentile(const std::vector<double>& sorted, const double fraction) {
+    if (sorted.empty()) return 0;
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())));
+    return sorted[index];
+}
+
+static double printStage(const char* name, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const double p99 = percentile(values, 0.99);
+    printf("  %s%-20s%s p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n", CLI_BLUE, name, CLI_RESET,
+        percentile(values, 0.5), p99, values.empty() ? 0 : values.back());
+    return p99;
+}
+
+double LatencyProbe::report() {
+    std::lock_guard lock(this->mutex);
+    printf("Latency over %s%zu%s of %s%lu%s clicks:\n", CLI_GREEN, this->endToEnd.size(), CLI_RESET,
+        CLI_GREEN, static_cast<unsigned long>(this->source.clicks.load()), CLI_RESET);
+    const double p99 = printStage("capture to pixel", this->endToEnd);
+    printStage("capture to render", this->captureToRender);
+    printStage("render to receive", this->renderToReceive);
+    return p99;
+}
@@ -0,0 +1,45 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef LATENCY_HPP
+#define LATENCY_HPP
+
+#define LATENCY_LIT_LEVEL 64
+#define LATENCY_LIT_FRACTION 0.05
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "codec.hpp"
+#include "source.hpp"
+
+// Matches frames arriving at the stand-in receiver against clicks injected by a ClickSource.
+// A click is detected on the first lit frame after a dark one. The stages come from the timestamps in the frame's
+// wire header, the sinks send frames on their own threads, so the render thread's newest ones may belong to a later frame.
+class LatencyProbe {
+    const ClickSource& source;
+
+    bool lit = false;
+    int64_t matchedClick = 0;
+
+    std::mutex mutex;
+    std::vector<double> endToEnd;
+    std::vector<double> captureToRender;
+    std::vector<double> renderToReceive;
+public:
+    explicit LatencyProbe(const ClickSource& source) : source(source) {}
+
+    // Receiver thread, info is the frame's wire header, all 0 for raw frames
+    void frameReceived(const unsigned char* pixels, size_t size, const WireFrameInfo& info);
+
+    size_t samples();
+    // Prints p50/p99/max per stage, returns the end-to-end p99 in milliseconds
+    double report();
+};
+
+
+
+#endif //LATENCY_HPP
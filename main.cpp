@@ -1,253 +1,331 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
 #include <stdexcept>
-#include <EGL/egl.h>
-#include <GLES2/gl2.h>
 #include <zmq.h>
 #include <csignal>
-#include <fstream>
-#include <iostream>
-#include <sstream> //std::stringstream
 #include <thread>
+#include <vector>
 
+#include "alloctrack.hpp"
 #include "audio.hpp"
-#include <glad/gl.h>
+#include "colorcli.hpp"
+#include "config.hpp"
+#include "framepool.hpp"
+#include "gputimer.hpp"
+#include "latency.hpp"
+#include "metrics.hpp"
+#include "output.hpp"
+#include "realtime.hpp"
+#include "receiver.hpp"
+#include "renderer.hpp"
+#include "sink.hpp"
+#include "scheduler.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
 
 constexpr int WIDTH = 128;
 constexpr int HEIGHT = 32;
+constexpr int ALLOC_CHECK_WARMUP_SECONDS = 2;
+constexpr int LATENCY_TEST_GRACE_MS = 5000;
+// How often an unpaced loop checks whether the silence is over
+constexpr int IDLE_POLL_MS = 10;
 
-void checkGLError(const char* msg) {
-    if (const GLenum err = glGetError(); err != GL_NO_ERROR) {
-        fprintf(stderr, "GL Error after %s: %x\n", msg, err);
-    }
-}
-
-EGLDisplay display;
-EGLContext context;
-EGLSurface surface;
+Renderer renderer;
 
 void *zmqContext;
-void *sender;
-
-GLint timeAttributeLocation;
-GLint resolutionAttributeLocation;
-GLint amplitudeAttributeLocation;
-GLuint fftSSBO;
-GLuint logFftSSBO;
 
 Audio audio;
 std::thread audioThread;
+Receiver receiver;
+std::unique_ptr<LatencyProbe> latencyProbe;
+FrameScheduler scheduler;
+GpuTimers gpuTimers;
+std::vector<std::unique_ptr<Sink>> sinks;
+std::atomic<bool> running = true;
+
+FramePool framePool;
+// Last frame read back, unchanged frames are not sent again
+FrameBuffer* previousFrame = nullptr;
+int64_t lastSendTime = 0;
+int64_t nextIdleFrame = 0;
     
 
 void destroy() {
-    zmq_close(sender);
+    gpuTimers.destroy();
     zmq_ctx_destroy(zmqContext);
     
-    eglDestroySurface(display, surface);
-    eglDestroyContext(display, context);
-    eglTerminate(display);
+    renderer.destroy();
     
     printf("Closed.\n");
 }
 
 void intHandler(int _) {
-    destroy();
+    running = false;
     audio.running = false;
 }
 
-void initZMQ() {
-    zmqContext = zmq_ctx_new();
-    sender = zmq_socket(zmqContext, ZMQ_REQ);
-    const int res = zmq_connect(sender, "tcp://matrix.kwsnet:5555");
-    printf("ZeroMQ: %d\n", res);
+void traceDumpHandler(int _) {
+    requestTraceDump();
 }
 
-void initEGL() {
-    if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE) {
-        throw std::runtime_error("Failed to bind OpenGL API");
+// TIP To <b>Run</b> code, press <shortcut actionId="Run"/> or
+// click the <icon src="AllIcons.Actions.Execute"/> icon in the gutter.
+int main(int argc, char** argv) {
+    Config config;
+    try {
+        config = parseConfig(argc, argv);
+    } catch (const std::runtime_error& e) {
+        fprintf(stderr, "%s\n", e.what());
+        printUsage(argv[0]);
+        return 1;
     }
 
-    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-    if(eglInitialize(display, nullptr, nullptr) != EGL_TRUE){
-        switch(eglGetError()){
-            case EGL_BAD_DISPLAY:
-                throw std::runtime_error("Failed to initialize EGL Display: EGL_BAD_DISPLAY");
-            case EGL_NOT_INITIALIZED:
-                throw std::runtime_error("Failed to initialize EGL Display: EGL_NOT_INITIALIZED");
-            default:
-                throw std::runtime_error("Failed to initialize EGL Display: unknown error");
+    if (config.allocCheckSeconds > 0) {
+        if (!allocationTrackingAvailable()) {
+            fprintf(stderr, "--alloc-check needs a build with TRACK_ALLOCATIONS\n");
+            return 1;
         }
+        config.source = "synthetic";
+        config.endpoint = "inproc://alloc-check";
     }
-
-    EGLConfig eglConfig;
-    EGLint numConfigs;
-    const EGLint eglConfigAttributes[] = {
-        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
-        EGL_RED_SIZE, 6, EGL_GREEN_SIZE, 6, EGL_BLUE_SIZE, 6, EGL_NONE
-    };
-    if(eglChooseConfig(display, eglConfigAttributes, &eglConfig, 1, &numConfigs) != EGL_TRUE){
-        switch(eglGetError()){
-            case EGL_BAD_DISPLAY:
-                throw std::runtime_error("Failed to configure EGL Display: EGL_BAD_DISPLAY");
-            case EGL_BAD_ATTRIBUTE:
-                throw std::runtime_error("Failed to configure EGL Display: EGL_BAD_ATTRIBUTE");
-            case EGL_NOT_INITIALIZED:
-                throw std::runtime_error("Failed to configure EGL Display: EGL_NOT_INITIALIZED");
-            case EGL_BAD_PARAMETER:
-                throw std::runtime_error("Failed to configure EGL Display: EGL_BAD_PARAMETER");
-            default:
-                throw std::runtime_error("Failed to configure EGL Display: unknown error");
-        }
+    if (config.latencyClicks > 0) {
+        config.source = "clicks";
+        config.endpoint = "inproc://latency-test";
     }
 
-    context = eglCreateContext(display, eglConfig, EGL_NO_CONTEXT, nullptr);
-    if (context == EGL_NO_CONTEXT) {
-        eglTerminate(display);
-        throw std::runtime_error("Failed to create EGL Context");
+    // The matrix is the first sink, the --output ones follow
+    std::vector<std::string> urls;
+    if (config.endpoint != "none") {
+        const char* separator = config.endpoint.find('?') == std::string::npos ? "?" : "&";
+        urls.push_back(config.wire == "raw" ? config.endpoint + separator + "wire=raw" : config.endpoint);
     }
-
-    constexpr EGLint eglSurfaceAttributes[] = {
-        EGL_WIDTH, WIDTH, EGL_HEIGHT, HEIGHT, EGL_NONE
-    };
-    surface = eglCreatePbufferSurface(display, eglConfig, eglSurfaceAttributes);
-    if (surface == EGL_NO_SURFACE) {
-        eglDestroyContext(display, context);
-        eglTerminate(display);
-        throw std::runtime_error("Failed to create EGL surface");
+    urls.insert(urls.end(), config.outputs.begin(), config.outputs.end());
+    zmqContext = zmq_ctx_new();
+    try {
+        sinks = createSinks(urls, SinkContext{zmqContext, WIDTH, HEIGHT, config.udpPaceUs});
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
     }
-
-    if (eglMakeCurrent(display, surface, surface, context) != EGL_TRUE) {
-        throw std::runtime_error("Failed to make EGL context current");
+    // Started before the audio thread so a bad target can still end main cleanly
+    if (!config.metrics.empty()) {
+        try {
+            startMetricsExport(config.metrics);
+        } catch (const std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
     }
-}
-
-void initOpenGL() {
-    gladLoadGL(eglGetProcAddress); 
-    glViewport(0, 0, WIDTH, HEIGHT);
-    
-    float vertices[] = {-1, -1, -1, 1, 1, 1, -1, -1, 1, -1, 1, 1};
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    
-    std::ifstream vertexShaderFile("shader.vert");
-    if (!vertexShaderFile.is_open()) {
-        throw std::runtime_error("Could not open shader.vert\n");
+    // Rendering faster than every sink takes frames only produces frames they all drop
+    bool allCapped = !sinks.empty();
+    int fastestSink = 0;
+    for (const auto& sink : sinks) {
+        allCapped = allCapped && sink->maxFps() > 0;
+        fastestSink = std::max(fastestSink, sink->maxFps());
     }
-    std::stringstream vertexShaderStream;
-    vertexShaderStream << vertexShaderFile.rdbuf();
-    std::string vertexShaderSource = vertexShaderStream.str();
-    const char *rawVertexShaderSource = vertexShaderSource.c_str();
-    
-    std::ifstream fragmentShaderFile("shader.frag");
-    if (!fragmentShaderFile.is_open()) {
-        throw std::runtime_error("Could not open shader.frag\n");
+    if (allCapped && (config.fps == 0 || config.fps > fastestSink)) {
+        config.fps = fastestSink;
+        printf("No sink takes more than %s%d%s fps, capping the frame rate\n", CLI_YELLOW, config.fps, CLI_RESET);
     }
-    std::stringstream fragmentShaderStream;
-    fragmentShaderStream << fragmentShaderFile.rdbuf();
-    std::string fragmentShaderSource = fragmentShaderStream.str();
-    const char *rawFragmentShaderSource = fragmentShaderSource.c_str();
 
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &rawVertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-    int success;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        std::cout << "Compiler Error: " << infoLog << std::endl;
-        throw std::runtime_error("Failed to compile vertex shader\n");
+    if (config.source == "synthetic") {
+        audio.init(std::make_unique<SyntheticSource>());
+    } else if (config.source == "clicks") {
+        auto clickSource = std::make_unique<ClickSource>();
+        latencyProbe = std::make_unique<LatencyProbe>(*clickSource);
+        audio.init(std::move(clickSource));
+    } else {
+        audio.init(std::make_unique<PortAudioSource>());
     }
-    
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &rawFragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        std::cout << "Compiler Error: " << infoLog << std::endl;
-        throw std::runtime_error("Failed to compile fragment shader\n");
+    audio.silenceLevel = std::pow(10.0f, static_cast<float>(config.silenceThresholdDb) / 20.0f);
+    if (config.realtime) {
+        lockMemory();
+        audio.prefaultBuffers = true;
     }
-    
-    unsigned int program = glCreateProgram();
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if(!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(program, 512, nullptr, infoLog);
-        std::cout << "Link Error: " << infoLog << std::endl;
-        throw std::runtime_error("Failed to link shaders\n");
+    if (!config.trace.empty()) {
+        startTracing(config.trace);
+        signal(SIGUSR1, traceDumpHandler);
     }
-
-    glUseProgram(program);
+    audioThread = std::thread([config] {
+        if (config.audioCpu >= 0) {
+            pinToCpu("audio", config.audioCpu);
+        }
+        if (config.realtime) {
+            setRealtimePriority("audio", config.realtimePriority);
+        }
+        registerRealtimeThread("audio");
+        traceThread("audio");
+        audio.start();
+    });
     
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    signal(SIGINT, intHandler);
+    // A pipe or socket whose reader went away fails the write instead of ending the process
+    signal(SIGPIPE, SIG_IGN);
 
-    timeAttributeLocation = glGetUniformLocation(program, "time");
-    resolutionAttributeLocation = glGetUniformLocation(program, "res");
-    amplitudeAttributeLocation = glGetUniformLocation(program, "amplitude");
-    
-    glGenBuffers(1, &fftSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, fftSSBO);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, fftSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (latencyProbe) {
+        receiver.onFrame = [](const unsigned char* frame, const size_t size, const WireFrameInfo& info) {
+            latencyProbe->frameReceived(frame, size, info);
+        };
+    }
+    if (config.allocCheckSeconds > 0 || config.latencyClicks > 0) {
+        receiver.start(zmqContext, config.endpoint);
+    }
+    for (const auto& sink : sinks) {
+        sink->start();
+    }
+    // Pin after the sink and ZMQ I/O threads exist so they do not inherit the render core
+    if (config.renderCpu >= 0) {
+        pinToCpu("render", config.renderCpu);
+    }
+    renderer.frames = [](const uint64_t index) -> const AnalysisFrame& {
+        return audio.frame(index);
+    };
+    renderer.oldestFrame = [] {
+        return audio.oldestFrame();
+    };
+    renderer.init(WIDTH, HEIGHT, "shader.vert", "shader.frag");
+    int poolBuffers = FRAME_POOL_BUFFERS;
+    for (const auto& sink : sinks) {
+        poolBuffers += sink->buffers();
+    }
+    framePool.init(poolBuffers, WIDTH * HEIGHT * 3);
+    gpuTimers.init();
     
-    glGenBuffers(1, &logFftSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, logFftSSBO);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, logFftSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-}
+    const int64_t startTime = steadyNanoseconds();
+    scheduler.init(config.fps);
+    registerRealtimeThread("render");
+    traceThread("render");
+    bool tracking = false;
+    while (running) {
+        const int64_t renderTime = scheduler.wait();
+        const auto elapsed = std::chrono::milliseconds((renderTime - startTime) / 1000000);
 
-// TIP To <b>Run</b> code, press <shortcut actionId="Run"/> or
-// click the <icon src="AllIcons.Actions.Execute"/> icon in the gutter.
-int main() {
-    audio.init();
-    audioThread = std::thread(&Audio::start, audio);
-    audioThread.detach();
-    
-    signal(SIGINT, intHandler);
+        if (config.allocCheckSeconds > 0) {
+            if (!tracking && elapsed >= std::chrono::seconds(ALLOC_CHECK_WARMUP_SECONDS)) {
+                startAllocationTracking();
+                tracking = true;
+            } else if (elapsed >= std::chrono::seconds(ALLOC_CHECK_WARMUP_SECONDS + config.allocCheckSeconds)) {
+                running = false;
+            }
+        }
+        if (config.latencyClicks > 0) {
+            const auto timeout = std::chrono::milliseconds(2 * config.latencyClicks * CLICK_INTERVAL_MS + LATENCY_TEST_GRACE_MS);
+            if (latencyProbe->samples() >= static_cast<size_t>(config.latencyClicks) || elapsed >= timeout) {
+                running = false;
+            }
+        }
+        // While silent only every idleFps-th slot is rendered, the others just check whether the sound is back
+        if (config.idleFps > 0 && audio.silent.load(std::memory_order_relaxed)) {
+            if (renderTime < nextIdleFrame) {
+                countEvent(Counter::IdleSkips);
+                if (config.fps == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_POLL_MS));
+                }
+                continue;
+            }
+            nextIdleFrame = renderTime + 1000000000LL / config.idleFps;
+        }
 
-    initZMQ();
-    initEGL();
-    initOpenGL();
-    
-    std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
-    std::chrono::high_resolution_clock::time_point lastFrameTime = std::chrono::high_resolution_clock::now();
-    while (true) {
-        auto currentFrameTime = std::chrono::high_resolution_clock::now();
-        printf("%ld\n", std::chrono::duration_cast<std::chrono::milliseconds>(currentFrameTime - lastFrameTime).count());
-        lastFrameTime = currentFrameTime;
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentFrameTime - startTime);
+        // Show the analysis frame captured latencyOffset before the moment this frame is expected to light up
+        const int64_t presentationTime = renderTime + config.outputLatencyMs * 1000000LL;
+        uint64_t frameIndex = 0;
+        const AnalysisFrame* frame = audio.frameAt(presentationTime - config.latencyOffsetMs * 1000000LL, frameIndex);
         
-        glClearColor(1.0, 0.0, 0.0, 1.0); // Red background
-        glClear(GL_COLOR_BUFFER_BIT);
+        // Unpaced, the slowest sink sets the rate instead of its queue dropping every other frame
+        if (config.fps == 0) {
+            for (const auto& sink : sinks) {
+                sink->waitForRoom();
+            }
+        }
 
-        glUniform1f(timeAttributeLocation, static_cast<float>(elapsed.count()));
-        glUniform2f(resolutionAttributeLocation, WIDTH, HEIGHT);
-        glUniform1f(amplitudeAttributeLocation, *audio.amplitude);
-        
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, fftSSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, FFW_BANDS*sizeof(fftw_complex), *audio.result, GL_DYNAMIC_DRAW); 
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, logFftSSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, audio.logResult->size()*sizeof(float), audio.logResult->data(), GL_DYNAMIC_DRAW); 
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-        
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        unsigned char pixels[WIDTH * HEIGHT * 3];
-        glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+        // Readback lands in a pooled buffer that every sink reads its pixels from
+        FrameBuffer* frameBuffer = framePool.acquire();
+        if (frameBuffer == nullptr) {
+            countEvent(Counter::PoolExhausted);
+            scheduler.frameDone();
+            continue;
+        }
+        frameBuffer->captureTime = frame != nullptr ? frame->captureTime : 0;
+        frameBuffer->renderTime = renderTime;
+
+        // GL calls run in a DriverScope inside the renderer and the GPU timers, their allocations are reported apart
+        gpuTimers.beginFrame();
+        if (frame != nullptr) {
+            StageTimer timer(Stage::Upload);
+            gpuTimers.begin(Stage::GpuUpload);
+            renderer.upload(*frame, frameIndex);
+            gpuTimers.end();
+        }
+
+        {
+            StageTimer timer(Stage::Draw);
+            gpuTimers.begin(Stage::GpuDraw);
+            renderer.draw(static_cast<float>(elapsed.count()));
+            gpuTimers.end();
+        }
+
+        {
+            // Waits for the GPU, so this includes the draw's execution time
+            StageTimer timer(Stage::Readback);
+            gpuTimers.begin(Stage::GpuReadback);
+            renderer.readback(frameBuffer->data.get());
+            gpuTimers.end();
+        }
 
-        zmq_send(sender, pixels, sizeof(pixels), 0);
-        zmq_recv(sender, nullptr, 0, 0);
+        // An unchanged frame is not sent again until the keepalive is due, the matrix keeps showing the last one
+        if (previousFrame != nullptr && config.keepaliveMs > 0
+            && renderTime - lastSendTime < config.keepaliveMs * 1000000LL
+            && std::memcmp(frameBuffer->data.get(), previousFrame->data.get(), WIDTH * HEIGHT * 3) == 0) {
+            frameBuffer->release();
+            countEvent(Counter::DuplicateFrames);
+            scheduler.frameDone();
+            continue;
+        }
+        lastSendTime = renderTime;
+
+        for (const auto& sink : sinks) {
+            sink->submit(frameBuffer, renderTime);
+        }
+        if (previousFrame != nullptr) {
+            previousFrame->release();
+        }
+        previousFrame = frameBuffer;
+        scheduler.frameDone();
     }
+    scheduler.report();
+
+    int status = 0;
+    if (stopAllocationTracking() > 0) {
+        status = 1;
+    }
+    if (config.allocCheckSeconds > 0) {
+        reportAllocations();
+    }
+    if (config.latencyClicks > 0) {
+        const double p99 = latencyProbe->report();
+        if (latencyProbe->samples() < static_cast<size_t>(config.latencyClicks)) {
+            printf("%sOnly %zu of %d clicks were detected%s\n", CLI_RED, latencyProbe->samples(), config.latencyClicks, CLI_RESET);
+            status = 1;
+        } else if (config.latencyBudgetMs > 0 && p99 > config.latencyBudgetMs) {
+            printf("%sp99 latency exceeds the budget of %d ms%s\n", CLI_RED, config.latencyBudgetMs, CLI_RESET);
+            status = 1;
+        }
+    }
+    // The capture loop writes into audio's buffers until it notices, join before they are destroyed
+    audio.running = false;
+    audioThread.join();
+    for (const auto& sink : sinks) {
+        sink->stop();
+    }
+    receiver.stop();
+    stopMetricsExport();
+    stopTracing();
+    destroy();
+    return status;
 }
 
 // TIP See CLion help at <a
@@ -0,0 +1,306 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "metrics.hpp"
+
+#include "colorcli.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+static const char* stageNames[] = {
+    "capture_wait", "fft", "bands", "upload", "draw", "readback", "encode", "send", "reply", "frame", "gpu_upload", "gpu_draw", "gpu_readback"
+};
+static_assert(std::size(stageNames) == static_cast<size_t>(Stage::Count));
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+};
+static const CounterInfo counterInfos[] = {
+    {"visualizer_frames_total", "Frame slots processed by the render loop"},
+    {"visualizer_late_frames_total", "Frames started after their deadline"},
+    {"visualizer_skipped_frames_total", "Frame slots given up because the render loop fell behind"},
+    {"visualizer_wire_bytes_total", "Bytes of frame messages sent to the matrix"},
+    {"visualizer_keyframes_total", "Encoded frames sent as keyframes"},
+    {"visualizer_frame_pool_exhausted_total", "Frames dropped because every pooled frame buffer was still referenced"},
+    {"visualizer_duplicate_frames_total", "Rendered frames not sent because they equal the last one sent"},
+    {"visualizer_idle_skips_total", "Frame slots not rendered because the input is silent"},
+    {"visualizer_udp_packets_total", "Packets sent to UDP LED controllers"},
+    {"visualizer_udp_send_errors_total", "Packets to UDP LED controllers that failed to send"},
+    {"visualizer_opc_connects_total", "TCP connections established to OPC servers"},
+    {"visualizer_serial_opens_total", "Serial LED devices opened"},
+};
+static_assert(std::size(counterInfos) == static_cast<size_t>(Counter::Count));
+
+// Bucket boundaries of the export, resolved to the nearest HDR bucket below
+static const int64_t exportBounds[] = {
+    10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000
+};
+
+static Histogram histograms[static_cast<size_t>(Stage::Count)];
+static SinkMetrics sinks[MAX_SINKS];
+static std::atomic<int> sinkCount = 0;
+static std::atomic<uint64_t> counters[static_cast<size_t>(Counter::Count)];
+
+static std::thread exportThread;
+static std::string socketPath;
+static std::atomic<bool> exporting = false;
+
+int Histogram::bucketOf(const int64_t nanoseconds) {
+    constexpr int64_t subBuckets = 1LL << HISTOGRAM_SUB_BUCKET_BITS;
+    if (nanoseconds < subBuckets) return static_cast<int>(std::max<int64_t>(nanoseconds, 0));
+    const uint64_t value = std::min<uint64_t>(nanoseconds, (1ULL << HISTOGRAM_MAX_BITS) - 1);
+    const int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BUCKET_BITS;
+    return static_cast<int>(((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) | ((value >> shift) & (subBuckets - 1)));
+}
+
+int64_t Histogram::bucketLimit(const int bucket) {
+    constexpr int64_t subBuckets = 1LL << HISTOGRAM_SUB_BUCKET_BITS;
+    if (bucket < subBuckets) return bucket;
+    const int shift = (bucket >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    const int64_t lower = (subBuckets + (bucket & (subBuckets - 1))) << shift;
+    return lower + (1LL << shift) - 1;
+}
+
+void Histogram::record(const int64_t nanoseconds) {
+    this->buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    this->total.fetch_add(1, std::memory_order_relaxed);
+    this->totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    int64_t current = this->maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > current && !this->maximum.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {}
+}
+
+uint64_t Histogram::countAtMost(const int64_t nanoseconds) const {
+    uint64_t count = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS && bucketLimit(bucket) <= nanoseconds; ++bucket) {
+        count += this->buckets[bucket].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+int64_t Histogram::percentile(const double fraction) const {
+    const uint64_t target = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(this->count())));
+    uint64_t count = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket) {
+        count += this->buckets[bucket].load(std::memory_order_relaxed);
+        if (count >= target && count > 0) return std::min(bucketLimit(bucket), this->max());
+    }
+    return this->max();
+}
+
+const char* stageName(const Stage stage) {
+    return stageNames[static_cast<size_t>(stage)];
+}
+
+Histogram& stageHistogram(const Stage stage) {
+    return histograms[static_cast<size_t>(stage)];
+}
+
+void recordStage(const Stage stage, const int64_t start, const int64_t end) {
+    histograms[static_cast<size_t>(stage)].record(end - start);
+    if (tracingEnabled()) {
+        traceEvent(stageNames[static_cast<size_t>(stage)], start, end);
+    }
+}
+
+void countEvent(const Counter counter, const uint64_t count) {
+    counters[static_cast<size_t>(counter)].fetch_add(count, std::memory_order_relaxed);
+}
+
+uint64_t counterValue(const Counter counter) {
+    return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+StageTimer::StageTimer(const Stage stage) : stage(stage), start(steadyNanoseconds()) {}
+
+StageTimer::~StageTimer() {
+    recordStage(this->stage, this->start, steadyNanoseconds());
+}
+
+SinkMetrics& registerSink(const std::string& name) {
+    const int index = sinkCount.load(std::memory_order_relaxed);
+    if (index >= MAX_SINKS) {
+        throw std::runtime_error("More than " + std::to_string(MAX_SINKS) + " outputs");
+    }
+    sinks[index].name = name;
+    sinkCount.store(index + 1, std::memory_order_release);
+    return sinks[index];
+}
+
+// Buckets, sum and count of one labelled series
+static void appendHistogram(std::string& text, const char* metric, const char* label, const char* value, const Histogram& histogram) {
+    char line[512];
+    for (const int64_t bound : exportBounds) {
+        snprintf(line, sizeof(line), "%s_bucket{%s=\"%s\",le=\"%g\"} %lu\n",
+            metric, label, value, static_cast<double>(bound) / 1e9, static_cast<unsigned long>(histogram.countAtMost(bound)));
+        text += line;
+    }
+    // Bucket counts are summed instead of using count() so a concurrent record cannot break monotonicity
+    const uint64_t count = histogram.countAtMost(INT64_MAX);
+    snprintf(line, sizeof(line), "%s_bucket{%s=\"%s\",le=\"+Inf\"} %lu\n", metric, label, value, static_cast<unsigned long>(count));
+    text += line;
+    snprintf(line, sizeof(line), "%s_sum{%s=\"%s\"} %.9f\n", metric, label, value, static_cast<double>(histogram.sum()) / 1e9);
+    text += line;
+    snprintf(line, sizeof(line), "%s_count{%s=\"%s\"} %lu\n", metric, label, value, static_cast<unsigned long>(count));
+    text += line;
+}
+
+std::string formatMetrics() {
+    std::string text;
+    char line[512];
+    text += "# HELP visualizer_stage_seconds Time spent in each pipeline stage\n";
+    text += "# TYPE visualizer_stage_seconds histogram\n";
+    for (size_t stage = 0; stage < static_cast<size_t>(Stage::Count); ++stage) {
+        appendHistogram(text, "visualizer_stage_seconds", "stage", stageNames[stage], histograms[stage]);
+    }
+    text += "# HELP visualizer_stage_max_seconds Longest time spent in each pipeline stage\n";
+    text += "# TYPE visualizer_stage_max_seconds gauge\n";
+    for (size_t stage = 0; stage < static_cast<size_t>(Stage::Count); ++stage) {
+        snprintf(line, sizeof(line), "visualizer_stage_max_seconds{stage=\"%s\"} %.9f\n",
+            stageNames[stage], static_cast<double>(histograms[stage].max()) / 1e9);
+        text += line;
+    }
+
+    const int registeredSinks = sinkCount.load(std::memory_order_acquire);
+    if (registeredSinks > 0) {
+        text += "# HELP visualizer_sink_latency_seconds Time from handing a frame to an output until it is sent\n";
+        text += "# TYPE visualizer_sink_latency_seconds histogram\n";
+        for (int sink = 0; sink < registeredSinks; ++sink) {
+            appendHistogram(text, "visualizer_sink_latency_seconds", "sink", sinks[sink].name.c_str(), sinks[sink].latency);
+        }
+        const struct {
+            const char* name;
+            const char* help;
+            std::atomic<uint64_t> SinkMetrics::* value;
+        } sinkCounters[] = {
+            {"visualizer_sink_frames_total", "Frames sent by each output", &SinkMetrics::sent},
+            {"visualizer_sink_dropped_total", "Frames an output dropped because its queue was full or sending failed", &SinkMetrics::dropped},
+            {"visualizer_sink_rate_limited_total", "Frames not handed to an output because of its rate cap", &SinkMetrics::rateLimited},
+        };
+        for (const auto& counter : sinkCounters) {
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n", counter.name, counter.help, counter.name);
+            text += line;
+            for (int sink = 0; sink < registeredSinks; ++sink) {
+                snprintf(line, sizeof(line), "%s{sink=\"%s\"} %lu\n", counter.name, sinks[sink].name.c_str(),
+                    static_cast<unsigned long>((sinks[sink].*counter.value).load(std::memory_order_relaxed)));
+                text += line;
+            }
+        }
+    }
+
+    for (size_t counter = 0; counter < static_cast<size_t>(Counter::Count); ++counter) {
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %lu\n",
+            counterInfos[counter].name, counterInfos[counter].help, counterInfos[counter].name,
+            counterInfos[counter].name, static_cast<unsigned long>(counters[counter].load(std::memory_order_relaxed)));
+        text += line;
+    }
+    return text;
+}
+
+static void writeAll(const int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result <= 0) return;
+        written += result;
+    }
+}
+
+// Answers every connection with the current metrics, good enough for curl --unix-socket and a Prometheus sidecar
+static void serveSocket(const int server) {
+    while (exporting) {
+        pollfd serverPoll{server, POLLIN, 0};
+        if (poll(&serverPoll, 1, METRICS_POLL_MS) <= 0) continue;
+        const int client = accept(server, nullptr, nullptr);
+        if (client < 0) continue;
+
+        // Drain the request if one is sent, a bare connect gets the metrics as well
+        pollfd clientPoll{client, POLLIN, 0};
+        if (poll(&clientPoll, 1, METRICS_POLL_MS) > 0) {
+            char request[1024];
+            [[maybe_unused]] const ssize_t ignored = read(client, request, sizeof(request));
+        }
+        const std::string body = formatMetrics();
+        writeAll(client, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+            + std::to_string(body.size()) + "\r\n\r\n" + body);
+        close(client);
+    }
+    close(server);
+}
+
+// Writes next to the target and renames, readers never see a partial file
+static void writeFile(const std::string& path) {
+    const std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "w");
+    if (file == nullptr) return;
+    const std::string body = formatMetrics();
+    fwrite(body.data(), 1, body.size(), file);
+    fclose(file);
+    rename(temporary.c_str(), path.c_str());
+}
+
+static void serveFile(const std::string& path) {
+    int64_t nextWrite = 0;
+    while (exporting) {
+        if (steadyNanoseconds() >= nextWrite) {
+            writeFile(path);
+            nextWrite = steadyNanoseconds() + METRICS_FILE_INTERVAL_MS * 1000000LL;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(METRICS_POLL_MS));
+    }
+    writeFile(path);
+}
+
+void startMetricsExport(const std::string& target) {
+    exporting = true;
+    if (target.rfind("unix:", 0) == 0) {
+        const std::string path = target.substr(5);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Metrics socket path too long: " + path);
+        }
+        strcpy(address.sun_path, path.c_str());
+
+        const int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(path.c_str());
+        if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(server, 4) != 0) {
+            const std::string error = strerror(errno);
+            if (server >= 0) close(server);
+            throw std::runtime_error("Cannot serve metrics on " + path + ": " + error);
+        }
+        printf("Serving metrics on %s%s%s\n", CLI_GREEN, path.c_str(), CLI_RESET);
+        socketPath = path;
+        exportThread = std::thread(serveSocket, server);
+    } else {
+        printf("Writing metrics to %s%s%s\n", CLI_GREEN, target.c_str(), CLI_RESET);
+        exportThread = std::thread(serveFile, target);
+    }
+}
+
+void stopMetricsExport() {
+    exporting = false;
+    if (exportThread.joinable()) {
+        exportThread.join();
+    }
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+}
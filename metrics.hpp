@@ -0,0 +1,117 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+// HDR-style buckets: every power of two is split into 2^HISTOGRAM_SUB_BUCKET_BITS linear buckets (~3% precision)
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+// Values from 1 ns up to 2^HISTOGRAM_MAX_BITS ns (~68 s), larger ones land in the last bucket
+#define HISTOGRAM_MAX_BITS 36
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS + 1) << HISTOGRAM_SUB_BUCKET_BITS)
+#define METRICS_POLL_MS 100
+#define METRICS_FILE_INTERVAL_MS 1000
+#define MAX_SINKS 32
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+enum class Stage {
+    CaptureWait,
+    FFT,
+    Bands,
+    Upload,
+    Draw,
+    Readback,
+    Encode,
+    Send,
+    Reply,
+    Frame,
+    // GPU execution time from timer queries, recorded a few frames late
+    GpuUpload,
+    GpuDraw,
+    GpuReadback,
+    Count
+};
+
+enum class Counter {
+    Frames,
+    LateFrames,
+    SkippedFrames,
+    WireBytes,
+    Keyframes,
+    PoolExhausted,
+    DuplicateFrames,
+    IdleSkips,
+    UdpPackets,
+    UdpSendErrors,
+    OpcConnects,
+    SerialOpens,
+    Count
+};
+
+// Lock-free, recording is a few relaxed atomic adds and safe from real-time threads
+class Histogram {
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+    std::atomic<uint64_t> total = 0;
+    std::atomic<int64_t> totalNanoseconds = 0;
+    std::atomic<int64_t> maximum = 0;
+public:
+    static int bucketOf(int64_t nanoseconds);
+    // Largest value that falls into the bucket
+    static int64_t bucketLimit(int bucket);
+
+    void record(int64_t nanoseconds);
+
+    uint64_t count() const { return this->total.load(std::memory_order_relaxed); }
+    int64_t sum() const { return this->totalNanoseconds.load(std::memory_order_relaxed); }
+    int64_t max() const { return this->maximum.load(std::memory_order_relaxed); }
+    // Number of values in buckets whose limit is at most nanoseconds
+    uint64_t countAtMost(int64_t nanoseconds) const;
+    int64_t percentile(double fraction) const;
+};
+
+const char* stageName(Stage stage);
+Histogram& stageHistogram(Stage stage);
+// Records the duration and, while tracing, a timeline event
+void recordStage(Stage stage, int64_t start, int64_t end);
+void countEvent(Counter counter, uint64_t count = 1);
+uint64_t counterValue(Counter counter);
+
+// One output sink, exported with a sink label
+struct SinkMetrics {
+    std::string name;
+    // From handing the frame to the sink until it is out
+    Histogram latency;
+    std::atomic<uint64_t> sent = 0;
+    // Replaced in a full queue or failed to send
+    std::atomic<uint64_t> dropped = 0;
+    // Not handed to the sink because of its rate cap
+    std::atomic<uint64_t> rateLimited = 0;
+};
+
+// Startup only, throws after MAX_SINKS
+SinkMetrics& registerSink(const std::string& name);
+
+// Times the enclosing scope into a stage histogram
+class StageTimer {
+    Stage stage;
+    int64_t start;
+public:
+    explicit StageTimer(Stage stage);
+    ~StageTimer();
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+};
+
+// Prometheus text exposition format of all stages, sinks and counters
+std::string formatMetrics();
+// target is either unix:PATH, served over HTTP to every connection, or a file rewritten every METRICS_FILE_INTERVAL_MS
+void startMetricsExport(const std::string& target);
+void stopMetricsExport();
+
+
+
+#endif //METRICS_HPP
@@ -0,0 +1,121 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "opc.hpp"
+
+#include "metrics.hpp"
+#include "output.hpp"
+#include "timing.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+bool isOpcTarget(const std::string& url) {
+    return url.starts_with("opc://");
+}
+
+void OpcSink::configure(const OutputUrl& parsed, int, int) {
+    if (parsed.host.empty()) {
+        throw std::runtime_error("Missing host in " + this->url);
+    }
+    const int port = parsed.port > 0 ? parsed.port : OPC_PORT;
+    for (const auto& [key, value] : parsed.parameters) {
+        if (key == "channel") {
+            this->channel = static_cast<unsigned char>(std::clamp(parseParameter(this->url, key, value), 0, 255));
+        } else {
+            throw std::runtime_error("Unknown parameter " + key + " in " + this->url);
+        }
+    }
+    if (this->pixelCount > OPC_MAX_PIXELS) {
+        throw std::runtime_error(std::to_string(this->pixelCount) + " pixels do not fit an OPC message: " + this->url);
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (const int error = getaddrinfo(parsed.host.c_str(), nullptr, &hints, &result); error != 0) {
+        throw std::runtime_error("Cannot resolve " + parsed.host + ": " + gai_strerror(error));
+    }
+    this->address = *reinterpret_cast<sockaddr_in*>(result->ai_addr);
+    freeaddrinfo(result);
+    this->address.sin_port = htons(port);
+
+    const uint16_t length = static_cast<uint16_t>(this->pixelCount * 3);
+    this->header[0] = this->channel;
+    this->header[1] = OPC_SET_PIXELS;
+    this->header[2] = static_cast<unsigned char>(length >> 8);
+    this->header[3] = static_cast<unsigned char>(length);
+}
+
+bool OpcSink::connect() {
+    if (steadyNanoseconds() < this->nextConnect) return false;
+    this->socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (this->socket < 0) {
+        this->disconnect();
+        return false;
+    }
+    // Every write is a whole frame, waiting to coalesce it with the next one only adds latency
+    constexpr int enable = 1;
+    setsockopt(this->socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    const int sendBuffer = static_cast<int>((OPC_HEADER_SIZE + this->pixelCount * 3) * OPC_QUEUED_FRAMES);
+    setsockopt(this->socket, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+    if (::connect(this->socket, reinterpret_cast<const sockaddr*>(&this->address), sizeof(this->address)) != 0) {
+        if (errno != EINPROGRESS) {
+            this->disconnect();
+            return false;
+        }
+        // Wait for the handshake in slices, so stopping is not held up by an unresponsive host
+        pollfd descriptor{this->socket, POLLOUT, 0};
+        while (poll(&descriptor, 1, SINK_POLL_MS) == 0) {
+            if (!this->running) {
+                this->disconnect();
+                return false;
+            }
+        }
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(this->socket, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            this->disconnect();
+            return false;
+        }
+    }
+    countEvent(Counter::OpcConnects);
+    return true;
+}
+
+void OpcSink::disconnect() {
+    this->close();
+    this->nextConnect = steadyNanoseconds() + OPC_RECONNECT_MS * 1000000LL;
+}
+
+bool OpcSink::send(FrameBuffer* frame) {
+    if (this->socket < 0 && !this->connect()) return false;
+    iovec parts[2] = {
+        {this->header, OPC_HEADER_SIZE},
+        {frame->data.get() + this->firstPixel * 3, this->pixelCount * 3},
+    };
+    if (!this->writeFully(this->socket, parts, 2, true)) {
+        // A frame cut off in the middle leaves the stream out of sync, only a new connection recovers it
+        this->disconnect();
+        return false;
+    }
+    return true;
+}
+
+void OpcSink::close() {
+    if (this->socket >= 0) {
+        ::close(this->socket);
+        this->socket = -1;
+    }
+}
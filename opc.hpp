@@ -0,0 +1,48 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef OPC_HPP
+#define OPC_HPP
+
+#define OPC_PORT 7890
+#define OPC_HEADER_SIZE 4
+#define OPC_SET_PIXELS 0
+// The length field is 16 bits
+#define OPC_MAX_PIXELS (65535 / 3)
+#define OPC_RECONNECT_MS 1000
+// Frames the kernel may queue for a slow server, more would only add latency before frames get dropped
+#define OPC_QUEUED_FRAMES 2
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <string>
+
+#include "sink.hpp"
+
+bool isOpcTarget(const std::string& url);
+
+// Open Pixel Control over a persistent TCP connection.
+// The header and the pooled frame go out in one sendmsg, no concatenation copy. A server that does not keep up
+// blocks only this sink's thread, its queue drops frames meanwhile. A lost connection is retried every OPC_RECONNECT_MS.
+class OpcSink : public Sink {
+    sockaddr_in address{};
+    unsigned char channel = 0;
+    unsigned char header[OPC_HEADER_SIZE] = {};
+
+    int socket = -1;
+    int64_t nextConnect = 0;
+
+    bool connect();
+    void disconnect();
+protected:
+    // opc://HOST[:PORT][?channel=N]
+    void configure(const OutputUrl& parsed, int width, int height) override;
+    bool send(FrameBuffer* frame) override;
+    void close() override;
+};
+
+
+
+#endif //OPC_HPP
@@ -0,0 +1,113 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "output.hpp"
+
+#include "config.hpp"
+#include "filesink.hpp"
+#include "opc.hpp"
+#include "serial.hpp"
+#include "shmsink.hpp"
+#include "udp.hpp"
+#include "zmqsink.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+OutputUrl parseOutputUrl(const std::string& url) {
+    const size_t schemeEnd = url.find("://");
+    if (schemeEnd == std::string::npos) {
+        throw std::runtime_error("Not an output URL: " + url);
+    }
+    OutputUrl result;
+    result.scheme = url.substr(0, schemeEnd);
+    std::string rest = url.substr(schemeEnd + 3);
+    std::string query;
+    if (const size_t separator = rest.find('?'); separator != std::string::npos) {
+        query = rest.substr(separator + 1);
+        rest = rest.substr(0, separator);
+    }
+    result.address = rest;
+    result.host = rest;
+    if (const size_t colon = rest.rfind(':'); colon != std::string::npos) {
+        result.host = rest.substr(0, colon);
+        try {
+            result.port = std::stoi(rest.substr(colon + 1));
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("Invalid port in " + url);
+        }
+    }
+
+    for (size_t start = 0; start < query.size();) {
+        size_t end = query.find('&', start);
+        if (end == std::string::npos) end = query.size();
+        const std::string parameter = query.substr(start, end - start);
+        const size_t equals = parameter.find('=');
+        result.parameters.emplace_back(parameter.substr(0, equals), equals == std::string::npos ? "" : parameter.substr(equals + 1));
+        start = end + 1;
+    }
+    return result;
+}
+
+int parseParameter(const std::string& url, const std::string& key, const std::string& value) {
+    const int result = parseInt(key + " in " + url, value);
+    if (result < 0) {
+        throw std::runtime_error("Invalid value for " + key + " in " + url + ": " + value);
+    }
+    return result;
+}
+
+bool isOutputUrl(const std::string& url) {
+    return isZmqTarget(url) || isUdpTarget(url) || isOpcTarget(url) || isSerialTarget(url) || isFileTarget(url)
+        || isShmTarget(url);
+}
+
+// Value of parameter key in url, empty when it has none
+static std::string parameterOf(const std::string& url, const std::string& key) {
+    for (const auto& [name, value] : parseOutputUrl(url).parameters) {
+        if (name == key) return value;
+    }
+    return "";
+}
+
+std::vector<std::unique_ptr<Sink>> createSinks(const std::vector<std::string>& urls, const SinkContext& context) {
+    // UDP controllers with the same fps and queue share one sink, it goes where the first of them was given
+    std::vector<std::pair<std::string, std::vector<std::string>>> udpGroups;
+    for (const std::string& url : urls) {
+        if (!isUdpTarget(url)) continue;
+        const std::string key = parameterOf(url, "fps") + "&" + parameterOf(url, "queue");
+        auto group = std::find_if(udpGroups.begin(), udpGroups.end(), [&](const auto& entry) { return entry.first == key; });
+        if (group == udpGroups.end()) {
+            udpGroups.emplace_back(key, std::vector<std::string>{url});
+        } else {
+            group->second.push_back(url);
+        }
+    }
+
+    std::vector<std::unique_ptr<Sink>> sinks;
+    for (const std::string& url : urls) {
+        std::unique_ptr<Sink> sink;
+        if (isZmqTarget(url)) {
+            sink = std::make_unique<ZmqSink>(context.zmqContext);
+        } else if (isUdpTarget(url)) {
+            auto group = std::find_if(udpGroups.begin(), udpGroups.end(), [&](const auto& entry) { return entry.second.front() == url; });
+            if (group == udpGroups.end()) continue;
+            sink = std::make_unique<UdpSink>(context.udpPaceMicroseconds, std::move(group->second));
+            udpGroups.erase(group);
+        } else if (isOpcTarget(url)) {
+            sink = std::make_unique<OpcSink>();
+        } else if (isSerialTarget(url)) {
+            sink = std::make_unique<SerialSink>();
+        } else if (isFileTarget(url)) {
+            sink = std::make_unique<FileSink>();
+        } else if (isShmTarget(url)) {
+            sink = std::make_unique<ShmSink>();
+        } else {
+            throw std::runtime_error("Unknown output: " + url);
+        }
+        sink->init(url, context.width, context.height);
+        sinks.push_back(std::move(sink));
+    }
+    return sinks;
+}
@@ -0,0 +1,43 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Sink;
+
+// scheme://ADDRESS[?key=value&...] of an --output, ADDRESS is split into host and port when it contains a colon
+struct OutputUrl {
+    std::string scheme;
+    std::string address;
+    std::string host;
+    int port = 0;
+    std::vector<std::pair<std::string, std::string>> parameters;
+};
+
+// Throws when url has no scheme or the port is not a number
+OutputUrl parseOutputUrl(const std::string& url);
+bool isOutputUrl(const std::string& url);
+// Parameter key of url as a number of at least 0, throws naming both otherwise
+int parseParameter(const std::string& url, const std::string& key, const std::string& value);
+
+// What sinks need from the process besides their URL
+struct SinkContext {
+    void* zmqContext = nullptr;
+    int width = 0;
+    int height = 0;
+    int udpPaceMicroseconds = 0;
+};
+
+// One initialized sink per URL, UDP controllers grouped into shared sinks, not started yet. Throws on errors.
+std::vector<std::unique_ptr<Sink>> createSinks(const std::vector<std::string>& urls, const SinkContext& context);
+
+
+
+#endif //OUTPUT_HPP
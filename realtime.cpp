@@ -0,0 +1,83 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "realtime.hpp"
+
+#include "colorcli.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static void printLimit(const int resource, const char* name) {
+    rlimit limit{};
+    if (getrlimit(resource, &limit) != 0) return;
+    if (limit.rlim_cur == RLIM_INFINITY) {
+        printf("  %s is unlimited\n", name);
+    } else {
+        printf("  %s is %llu\n", name, static_cast<unsigned long long>(limit.rlim_cur));
+    }
+}
+
+bool setRealtimePriority(const char* thread, const int priority) {
+    sched_param param{};
+    param.sched_priority = priority;
+    if (const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); err != 0) {
+        printf(CLI_YELLOW "Cannot set SCHED_FIFO priority %d for %s thread: %s%s\n", priority, thread, strerror(err), CLI_RESET);
+        if (err == EPERM) {
+            printLimit(RLIMIT_RTPRIO, "RLIMIT_RTPRIO");
+            printf("  Grant CAP_SYS_NICE or raise rtprio in /etc/security/limits.conf\n");
+        }
+        return false;
+    }
+    printf("Running %s%s%s thread with SCHED_FIFO priority %d\n", CLI_GREEN, thread, CLI_RESET, priority);
+    return true;
+}
+
+bool pinToCpu(const char* thread, const int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); err != 0) {
+        printf(CLI_YELLOW "Cannot pin %s thread to CPU %d: %s%s\n", thread, cpu, strerror(err), CLI_RESET);
+        return false;
+    }
+    printf("Pinned %s%s%s thread to CPU %d\n", CLI_GREEN, thread, CLI_RESET, cpu);
+    return true;
+}
+
+bool lockMemory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        const int err = errno;
+        printf(CLI_YELLOW "Cannot lock memory: %s%s\n", strerror(err), CLI_RESET);
+        if (err == EPERM || err == ENOMEM) {
+            printLimit(RLIMIT_MEMLOCK, "RLIMIT_MEMLOCK");
+            printf("  Grant CAP_IPC_LOCK or raise memlock in /etc/security/limits.conf\n");
+        }
+        return false;
+    }
+    printf("Locked process memory\n");
+    return true;
+}
+
+void prefault(void* memory, const size_t size) {
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    volatile char* bytes = static_cast<volatile char*>(memory);
+    for (size_t offset = 0; offset < size; offset += pageSize) {
+        bytes[offset] = bytes[offset];
+    }
+    if (size > 0) {
+        bytes[size - 1] = bytes[size - 1];
+    }
+}
+
+void prefaultStack() {
+    volatile char stack[PREFAULT_STACK_SIZE];
+    prefault(const_cast<char*>(stack), sizeof(stack));
+}
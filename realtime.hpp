@@ -0,0 +1,24 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#define PREFAULT_STACK_SIZE (256*1024)
+
+#include <cstddef>
+
+// All functions print a diagnostic and return false when the privilege is missing,
+// the caller keeps running without the guarantee.
+bool setRealtimePriority(const char* thread, int priority);
+bool pinToCpu(const char* thread, int cpu);
+bool lockMemory();
+
+// Touches every page so the first real-time access does not page fault
+void prefault(void* memory, size_t size);
+void prefaultStack();
+
+
+
+#endif //REALTIME_HPP
@@ -0,0 +1,86 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include <zmq.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "colorcli.hpp"
+#include "receiver.hpp"
+#include "timing.hpp"
+
+#define RECEIVE_REPORT_MS 1000
+
+struct Options {
+    std::string bind = "tcp://*:5555";
+    int seconds = 0;
+    int reportMs = RECEIVE_REPORT_MS;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void intHandler(int) {
+    running = 0;
+}
+
+static Options parseOptions(const int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t separator = arg.find('=');
+        const std::string option = arg.substr(0, separator);
+        const std::string value = separator == std::string::npos ? "" : arg.substr(separator + 1);
+        if (option == "--bind") {
+            options.bind = value;
+        } else if (option == "--seconds") {
+            options.seconds = std::stoi(value);
+        } else if (option == "--report") {
+            options.reportMs = std::max(1, std::stoi(value));
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    return options;
+}
+
+// Stand-in for the matrix on another machine or port: decodes and acknowledges every frame like the matrix does and
+// reports drop rate, jitter and one-way latency from the frame headers. Point the display's --endpoint at it.
+int main(const int argc, char** argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        fprintf(stderr, "Usage: %s [--bind=ENDPOINT] [--seconds=N] [--report=MS]\n", argv[0]);
+        return 1;
+    }
+
+    void* context = zmq_ctx_new();
+    Receiver receiver;
+    receiver.reportMs = options.reportMs;
+    try {
+        receiver.start(context, options.bind);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        zmq_ctx_destroy(context);
+        return 1;
+    }
+    printf("Receiving on %s%s%s\n", CLI_GREEN, options.bind.c_str(), CLI_RESET);
+    signal(SIGINT, intHandler);
+
+    const int64_t end = options.seconds > 0 ? steadyNanoseconds() + options.seconds * 1000000000LL : INT64_MAX;
+    while (running && steadyNanoseconds() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(RECEIVER_POLL_MS));
+    }
+    receiver.stop();
+    printf("Received %s%lu%s frames\n", CLI_GREEN, static_cast<unsigned long>(receiver.frames.load()), CLI_RESET);
+    zmq_ctx_destroy(context);
+    return 0;
+}
@@ -0,0 +1,63 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "receiver.hpp"
+
+#include "timing.hpp"
+#include "trace.hpp"
+
+#include <zmq.h>
+
+#include <stdexcept>
+
+void Receiver::start(void* context, const std::string& endpoint) {
+    this->socket = zmq_socket(context, ZMQ_REP);
+    constexpr int timeout = RECEIVER_POLL_MS;
+    zmq_setsockopt(this->socket, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+    if (zmq_bind(this->socket, endpoint.c_str()) != 0) {
+        zmq_close(this->socket);
+        throw std::runtime_error("Cannot bind receiver to " + endpoint + ": " + zmq_strerror(zmq_errno()));
+    }
+
+    this->running = true;
+    this->thread = std::thread(&Receiver::run, this);
+}
+
+void Receiver::run() {
+    traceThread("receiver");
+    int64_t nextReport = steadyNanoseconds() + this->reportMs * 1000000LL;
+    while (this->running) {
+        if (this->reportMs > 0 && steadyNanoseconds() >= nextReport) {
+            this->stats.report();
+            nextReport += this->reportMs * 1000000LL;
+        }
+        // A message of its own size, a fixed buffer would truncate frames of large canvases
+        zmq_msg_t message;
+        zmq_msg_init(&message);
+        if (zmq_msg_recv(&message, this->socket, 0) < 0) {
+            zmq_msg_close(&message);
+            continue;
+        }
+        const int64_t received = steadyNanoseconds();
+        const auto* frame = static_cast<const unsigned char*>(zmq_msg_data(&message));
+        const size_t size = zmq_msg_size(&message);
+        ++this->frames;
+        this->stats.add(frame, size, wallNanoseconds());
+        if (this->decoder.decode(frame, size) && this->onFrame) {
+            this->onFrame(this->decoder.pixels(), this->decoder.size(), this->decoder.info());
+        }
+        zmq_msg_close(&message);
+        const unsigned char flags = WIRE_REPLY_ENCODED | (this->decoder.needsKeyframe() ? WIRE_REPLY_KEYFRAME : 0);
+        zmq_send(this->socket, &flags, 1, 0);
+        traceEvent("receive", received, steadyNanoseconds());
+    }
+    zmq_close(this->socket);
+}
+
+void Receiver::stop() {
+    this->running = false;
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+}
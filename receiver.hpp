@@ -0,0 +1,41 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef RECEIVER_HPP
+#define RECEIVER_HPP
+
+#define RECEIVER_POLL_MS 100
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "codec.hpp"
+#include "wirestats.hpp"
+
+// Local stand-in for the matrix: a REP socket that decodes and acknowledges every frame
+class Receiver {
+    void *socket = nullptr;
+    std::thread thread;
+    std::atomic<bool> running = false;
+    FrameDecoder decoder;
+    WireStats stats;
+
+    void run();
+public:
+    void start(void* context, const std::string& endpoint);
+    void stop();
+
+    std::atomic<uint64_t> frames = 0;
+    // Prints drops, jitter and latency of the incoming frames this often from the receiver thread, 0 never
+    int reportMs = 0;
+    // Called on the receiver thread with every decoded RGB frame and its wire header before it is acknowledged
+    std::function<void(const unsigned char* frame, size_t size, const WireFrameInfo& info)> onFrame;
+};
+
+
+
+#endif //RECEIVER_HPP
@@ -0,0 +1,295 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "renderer.hpp"
+
+#include "alloctrack.hpp"
+
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+void checkGLError(const char* msg) {
+    if (const GLenum err = glGetError(); err != GL_NO_ERROR) {
+        fprintf(stderr, "GL Error after %s: %x\n", msg, err);
+    }
+}
+
+void Renderer::initEGL() {
+    if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE) {
+        throw std::runtime_error("Failed to bind OpenGL API");
+    }
+
+    this->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (eglInitialize(this->display, nullptr, nullptr) != EGL_TRUE) {
+        // Headless machines without a window system still render through Mesa's surfaceless platform
+        const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay != nullptr) {
+            this->display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+    }
+    if(eglInitialize(this->display, nullptr, nullptr) != EGL_TRUE){
+        switch(eglGetError()){
+            case EGL_BAD_DISPLAY:
+                throw std::runtime_error("Failed to initialize EGL Display: EGL_BAD_DISPLAY");
+            case EGL_NOT_INITIALIZED:
+                throw std::runtime_error("Failed to initialize EGL Display: EGL_NOT_INITIALIZED");
+            default:
+                throw std::runtime_error("Failed to initialize EGL Display: unknown error");
+        }
+    }
+
+    EGLConfig eglConfig;
+    EGLint numConfigs;
+    const EGLint eglConfigAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 6, EGL_GREEN_SIZE, 6, EGL_BLUE_SIZE, 6, EGL_NONE
+    };
+    if(eglChooseConfig(this->display, eglConfigAttributes, &eglConfig, 1, &numConfigs) != EGL_TRUE){
+        switch(eglGetError()){
+            case EGL_BAD_DISPLAY:
+                throw std::runtime_error("Failed to configure EGL Display: EGL_BAD_DISPLAY");
+            case EGL_BAD_ATTRIBUTE:
+                throw std::runtime_error("Failed to configure EGL Display: EGL_BAD_ATTRIBUTE");
+            case EGL_NOT_INITIALIZED:
+                throw std::runtime_error("Failed to configure EGL Display: EGL_NOT_INITIALIZED");
+            case EGL_BAD_PARAMETER:
+                throw std::runtime_error("Failed to configure EGL Display: EGL_BAD_PARAMETER");
+            default:
+                throw std::runtime_error("Failed to configure EGL Display: unknown error");
+        }
+    }
+
+    this->context = eglCreateContext(this->display, eglConfig, EGL_NO_CONTEXT, nullptr);
+    if (this->context == EGL_NO_CONTEXT) {
+        eglTerminate(this->display);
+        throw std::runtime_error("Failed to create EGL Context");
+    }
+
+    const EGLint eglSurfaceAttributes[] = {
+        EGL_WIDTH, this->width, EGL_HEIGHT, this->height, EGL_NONE
+    };
+    this->surface = eglCreatePbufferSurface(this->display, eglConfig, eglSurfaceAttributes);
+    if (this->surface == EGL_NO_SURFACE) {
+        eglDestroyContext(this->display, this->context);
+        eglTerminate(this->display);
+        throw std::runtime_error("Failed to create EGL surface");
+    }
+
+    if (eglMakeCurrent(this->display, this->surface, this->surface, this->context) != EGL_TRUE) {
+        throw std::runtime_error("Failed to make EGL context current");
+    }
+}
+
+void Renderer::initOpenGL(const std::string& vertexShaderPath, const std::string& fragmentShaderPath) {
+    gladLoadGL(eglGetProcAddress); 
+    glViewport(0, 0, this->width, this->height);
+    
+    float vertices[] = {-1, -1, -1, 1, 1, 1, -1, -1, 1, -1, 1, 1};
+    unsigned int VBO;
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    
+    std::ifstream vertexShaderFile(vertexShaderPath);
+    if (!vertexShaderFile.is_open()) {
+        throw std::runtime_error("Could not open " + vertexShaderPath + "\n");
+    }
+    std::stringstream vertexShaderStream;
+    vertexShaderStream << vertexShaderFile.rdbuf();
+    std::string vertexShaderSource = vertexShaderStream.str();
+    const char *rawVertexShaderSource = vertexShaderSource.c_str();
+    
+    std::ifstream fragmentShaderFile(fragmentShaderPath);
+    if (!fragmentShaderFile.is_open()) {
+        throw std::runtime_error("Could not open " + fragmentShaderPath + "\n");
+    }
+    std::stringstream fragmentShaderStream;
+    fragmentShaderStream << fragmentShaderFile.rdbuf();
+    std::string fragmentShaderSource = fragmentShaderStream.str();
+    const char *rawFragmentShaderSource = fragmentShaderSource.c_str();
+
+    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &rawVertexShaderSource, nullptr);
+    glCompileShader(vertexShader);
+    int success;
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
+        std::cout << "Compiler Error: " << infoLog << std::endl;
+        throw std::runtime_error("Failed to compile vertex shader\n");
+    }
+    
+    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &rawFragmentShaderSource, nullptr);
+    glCompileShader(fragmentShader);
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
+        std::cout << "Compiler Error: " << infoLog << std::endl;
+        throw std::runtime_error("Failed to compile fragment shader\n");
+    }
+    
+    this->program = glCreateProgram();
+    glAttachShader(this->program, vertexShader);
+    glAttachShader(this->program, fragmentShader);
+    glLinkProgram(this->program);
+    glGetProgramiv(this->program, GL_LINK_STATUS, &success);
+    if(!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(this->program, 512, nullptr, infoLog);
+        std::cout << "Link Error: " << infoLog << std::endl;
+        throw std::runtime_error("Failed to link shaders\n");
+    }
+
+    glUseProgram(this->program);
+    
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    this->timeAttributeLocation = glGetUniformLocation(this->program, "time");
+    this->resolutionAttributeLocation = glGetUniformLocation(this->program, "res");
+    this->amplitudeAttributeLocation = glGetUniformLocation(this->program, "amplitude");
+    this->channelsAttributeLocation = glGetUniformLocation(this->program, "channels");
+    this->historyHeadAttributeLocation = glGetUniformLocation(this->program, "historyHead");
+    this->waveformHeadAttributeLocation = glGetUniformLocation(this->program, "waveformHead");
+    glUniform1i(glGetUniformLocation(this->program, "history"), 0);
+    
+    // Storage is allocated once for MAX_CHANNELS, frames only update it with glBufferSubData
+    glGenBuffers(1, &this->fftSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->fftSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_CHANNELS*FFW_BANDS*sizeof(fftwf_complex), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->fftSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    
+    glGenBuffers(1, &this->logFftSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->logFftSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_CHANNELS*LOG_BANDS*sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->logFftSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &this->waveformSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->waveformSSBO);
+    std::vector<float> emptyWaveform(WAVEFORM_LENGTH*2);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, emptyWaveform.size()*sizeof(float), emptyWaveform.data(), GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->waveformSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &this->stereoSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->stereoSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, LOG_BANDS*4*sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, this->stereoSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenTextures(1, &this->historyTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->historyTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, LOG_BANDS, HISTORY_LENGTH);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    std::vector<float> emptyHistory(LOG_BANDS*HISTORY_LENGTH);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LOG_BANDS, HISTORY_LENGTH, GL_RED, GL_FLOAT, emptyHistory.data());
+    checkGLError("history texture");
+}
+
+// Uploads only the rows of frames newer than the last upload, so bandwidth is independent of HISTORY_LENGTH
+void Renderer::uploadHistory(const uint64_t index) {
+    if (index + 1 - this->uploadedHistoryFrames > HISTORY_LENGTH) {
+        this->uploadedHistoryFrames = index + 1 - HISTORY_LENGTH;
+    }
+    // After a stall the ring no longer holds the whole history, those rows keep what they had
+    this->uploadedHistoryFrames = std::max(this->uploadedHistoryFrames, this->oldestFrame());
+    for (; this->uploadedHistoryFrames <= index; ++this->uploadedHistoryFrames) {
+        const int row = static_cast<int>(this->uploadedHistoryFrames % HISTORY_LENGTH);
+        const float* bands = this->frames(this->uploadedHistoryFrames).bands;
+        DriverScope driver;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, LOG_BANDS, 1, GL_RED, GL_FLOAT, bands);
+    }
+    DriverScope driver;
+    glUniform1i(this->historyHeadAttributeLocation, static_cast<int>(index % HISTORY_LENGTH));
+}
+
+// Uploads only the min/max columns of frames newer than the last upload
+void Renderer::uploadWaveform(const uint64_t index) {
+    constexpr uint64_t framesPerRing = WAVEFORM_LENGTH / WAVEFORM_COLUMNS;
+    if (index + 1 - this->uploadedWaveformFrames > framesPerRing) {
+        this->uploadedWaveformFrames = index + 1 - framesPerRing;
+    }
+    this->uploadedWaveformFrames = std::max(this->uploadedWaveformFrames, this->oldestFrame());
+    {
+        DriverScope driver;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->waveformSSBO);
+    }
+    for (; this->uploadedWaveformFrames <= index; ++this->uploadedWaveformFrames) {
+        const uint64_t start = (this->uploadedWaveformFrames * WAVEFORM_COLUMNS) % WAVEFORM_LENGTH;
+        const float* waveform = this->frames(this->uploadedWaveformFrames).waveform;
+        DriverScope driver;
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, start*2*sizeof(float), WAVEFORM_COLUMNS*2*sizeof(float), waveform);
+    }
+    DriverScope driver;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glUniform1i(this->waveformHeadAttributeLocation, static_cast<int>(((index + 1) * WAVEFORM_COLUMNS - 1) % WAVEFORM_LENGTH));
+}
+
+// GL calls on the render path run in a DriverScope, the driver's allocations are not ours to avoid.
+// Everything else in upload, draw and readback has to stay allocation-free for --alloc-check.
+void Renderer::upload(const AnalysisFrame& frame, const uint64_t index) {
+    {
+        DriverScope driver;
+        glUniform1f(this->amplitudeAttributeLocation, frame.amplitude);
+        glUniform1i(this->channelsAttributeLocation, frame.channels);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->fftSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, frame.channels*FFW_BANDS*sizeof(fftwf_complex), frame.spectrum);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->logFftSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, frame.channels*LOG_BANDS*sizeof(float), frame.bands);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->stereoSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(frame.stereo), frame.stereo);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    this->uploadHistory(index);
+    this->uploadWaveform(index);
+}
+
+void Renderer::init(const int width, const int height, const std::string& vertexShaderPath, const std::string& fragmentShaderPath) {
+    this->width = width;
+    this->height = height;
+    this->initEGL();
+    this->initOpenGL(vertexShaderPath, fragmentShaderPath);
+}
+
+void Renderer::destroy() {
+    eglDestroySurface(this->display, this->surface);
+    eglDestroyContext(this->display, this->context);
+    eglTerminate(this->display);
+}
+
+void Renderer::draw(const float time) {
+    DriverScope driver;
+    glClearColor(1.0, 0.0, 0.0, 1.0); // Red background
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUniform1f(this->timeAttributeLocation, time);
+    glUniform2f(this->resolutionAttributeLocation, static_cast<float>(this->width), static_cast<float>(this->height));
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void Renderer::readback(unsigned char* pixels) {
+    DriverScope driver;
+    glReadPixels(0, 0, this->width, this->height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+}
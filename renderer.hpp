@@ -0,0 +1,65 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef RENDERER_HPP
+#define RENDERER_HPP
+
+#include <EGL/egl.h>
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "audio.hpp"
+
+// Headless EGL context that runs one fragment shader over a pbuffer and reads the pixels back as RGB
+class Renderer {
+    int width = 0;
+    int height = 0;
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+    GLuint program = 0;
+    GLint timeAttributeLocation = -1;
+    GLint resolutionAttributeLocation = -1;
+    GLint amplitudeAttributeLocation = -1;
+    GLint channelsAttributeLocation = -1;
+    GLint historyHeadAttributeLocation = -1;
+    GLint waveformHeadAttributeLocation = -1;
+    GLuint fftSSBO = 0;
+    GLuint logFftSSBO = 0;
+    GLuint waveformSSBO = 0;
+    GLuint stereoSSBO = 0;
+    GLuint historyTexture = 0;
+    uint64_t uploadedHistoryFrames = 0;
+    uint64_t uploadedWaveformFrames = 0;
+
+    void initEGL();
+    void initOpenGL(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+    void uploadHistory(uint64_t index);
+    void uploadWaveform(uint64_t index);
+public:
+    // Older frames by index, history and waveform rows of frames between two uploads are read through this
+    std::function<const AnalysisFrame&(uint64_t index)> frames;
+    // Index of the oldest frame frames() may still be asked for
+    std::function<uint64_t()> oldestFrame;
+
+    void init(int width, int height, const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+    void destroy();
+
+    void upload(const AnalysisFrame& frame, uint64_t index);
+    // time is in milliseconds
+    void draw(float time);
+    // pixels holds width*height*3 bytes
+    void readback(unsigned char* pixels);
+};
+
+void checkGLError(const char* msg);
+
+
+
+#endif //RENDERER_HPP
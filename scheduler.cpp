@@ -0,0 +1,76 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "scheduler.hpp"
+
+#include "colorcli.hpp"
+#include "metrics.hpp"
+#include "timing.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+
+// steady_clock is CLOCK_MONOTONIC on Linux, deadlines can be handed to clock_nanosleep as they are
+static void sleepUntil(const int64_t deadline) {
+    timespec time{};
+    time.tv_sec = deadline / 1000000000LL;
+    time.tv_nsec = deadline % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) {}
+}
+
+void FrameScheduler::init(const int fps) {
+    this->period = fps > 0 ? 1000000000LL / fps : 0;
+    this->deadline = 0;
+}
+
+int64_t FrameScheduler::wait() {
+    const int64_t now = steadyNanoseconds();
+    if (this->firstFrame == 0) {
+        this->firstFrame = now;
+    }
+    if (this->period == 0) {
+        this->frameStart = now;
+        return now;
+    }
+
+    this->deadline = this->deadline == 0 ? now : this->deadline + this->period;
+    const int64_t lateness = now - this->deadline;
+    if (lateness > this->period / FRAME_LATE_FRACTION) {
+        // Skip to the next slot on the grid rather than catching up
+        const int64_t missed = lateness / this->period + 1;
+        countEvent(Counter::SkippedFrames, missed);
+        this->deadline += missed * this->period;
+    } else if (lateness > 0) {
+        countEvent(Counter::LateFrames);
+        this->maxLateness = std::max(this->maxLateness, lateness);
+    }
+    if (this->deadline > now) {
+        sleepUntil(this->deadline);
+    }
+    this->frameStart = std::max(now, this->deadline);
+    return this->frameStart;
+}
+
+void FrameScheduler::frameDone() {
+    recordStage(Stage::Frame, this->frameStart, steadyNanoseconds());
+    countEvent(Counter::Frames);
+}
+
+void FrameScheduler::report() const {
+    const uint64_t frames = counterValue(Counter::Frames);
+    if (frames == 0) return;
+    const Histogram& frameTime = stageHistogram(Stage::Frame);
+    const double seconds = static_cast<double>(steadyNanoseconds() - this->firstFrame) / 1e9;
+    printf("Rendered %s%lu%s frames at %s%.1f%s fps, %lu late (max %.2f ms), %lu slots skipped\n",
+        CLI_GREEN, static_cast<unsigned long>(frames), CLI_RESET,
+        CLI_GREEN, static_cast<double>(frames) / seconds, CLI_RESET,
+        static_cast<unsigned long>(counterValue(Counter::LateFrames)), static_cast<double>(this->maxLateness) / 1e6,
+        static_cast<unsigned long>(counterValue(Counter::SkippedFrames)));
+    printf("Frame time avg %.2f ms, p99 %.2f ms, max %.2f ms\n",
+        static_cast<double>(frameTime.sum()) / static_cast<double>(frameTime.count()) / 1e6,
+        static_cast<double>(frameTime.percentile(0.99)) / 1e6,
+        static_cast<double>(frameTime.max()) / 1e6);
+}
@@ -0,0 +1,37 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+// A frame starting later than this fraction of the period gives up its slot and waits for the next one
+#define FRAME_LATE_FRACTION 4
+
+#include <cstdint>
+
+// Paces the render loop on a fixed grid of absolute steady_clock deadlines.
+// Slots that were missed are skipped instead of rendered back to back, so the matrix never sees a burst.
+// Frame counts and times go into the metrics (Counter::Frames, Stage::Frame, ...).
+class FrameScheduler {
+    int64_t period = 0;
+    int64_t deadline = 0;
+    int64_t frameStart = 0;
+
+    int64_t maxLateness = 0;
+    int64_t firstFrame = 0;
+public:
+    // fps 0 runs unpaced
+    void init(int fps);
+
+    // Sleeps until the next deadline, returns the steady_clock nanoseconds the frame starts at
+    int64_t wait();
+    // Records how long the frame since the last wait() took into Stage::Frame
+    void frameDone();
+
+    void report() const;
+};
+
+
+
+#endif //SCHEDULER_HPP
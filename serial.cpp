@@ -0,0 +1,138 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "serial.hpp"
+
+#include "metrics.hpp"
+#include "output.hpp"
+#include "timing.hpp"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+static const unsigned char tpm2Footer[1] = {TPM2_FRAME_END};
+
+static speed_t baudConstant(const int baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 500000: return B500000;
+        case 576000: return B576000;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        default: throw std::runtime_error("Unsupported baud rate: " + std::to_string(baud));
+    }
+}
+
+bool isSerialTarget(const std::string& url) {
+    return url.starts_with("serial://");
+}
+
+void SerialSink::configure(const OutputUrl& parsed, int, int) {
+    this->path = parsed.address;
+    if (this->path.empty()) {
+        throw std::runtime_error("Missing device in " + this->url);
+    }
+    for (const auto& [key, value] : parsed.parameters) {
+        if (key == "baud") {
+            this->baud = parseParameter(this->url, key, value);
+        } else if (key == "protocol" && (value == "adalight" || value == "tpm2")) {
+            this->protocol = value == "tpm2" ? SerialProtocol::TPM2 : SerialProtocol::Adalight;
+        } else {
+            throw std::runtime_error("Unknown parameter " + key + " in " + this->url);
+        }
+    }
+    baudConstant(this->baud);
+    // Adalight counts LEDs and TPM2 bytes in 16 bits
+    const size_t limit = this->protocol == SerialProtocol::Adalight ? 65536 : 65535 / 3;
+    if (this->pixelCount > limit) {
+        throw std::runtime_error(std::to_string(this->pixelCount) + " pixels do not fit a frame of " + this->url);
+    }
+
+    if (this->protocol == SerialProtocol::Adalight) {
+        // "Ada", LED count - 1 big endian and a checksum over it
+        const uint16_t leds = static_cast<uint16_t>(this->pixelCount - 1);
+        std::memcpy(this->header, "Ada", 3);
+        this->header[3] = static_cast<unsigned char>(leds >> 8);
+        this->header[4] = static_cast<unsigned char>(leds);
+        this->header[5] = this->header[3] ^ this->header[4] ^ 0x55;
+        this->headerSize = ADALIGHT_HEADER_SIZE;
+    } else {
+        const uint16_t size = static_cast<uint16_t>(this->pixelCount * 3);
+        this->header[0] = TPM2_FRAME_START;
+        this->header[1] = TPM2_DATA_FRAME;
+        this->header[2] = static_cast<unsigned char>(size >> 8);
+        this->header[3] = static_cast<unsigned char>(size);
+        this->headerSize = TPM2_HEADER_SIZE;
+    }
+
+    // Rendering faster than the baud rate carries only produces frames the device cannot take
+    const int maxFps = std::max(1, static_cast<int>(this->baud / SERIAL_BITS_PER_BYTE / this->frameBytes()));
+    if (this->fps == 0 || this->fps > maxFps) {
+        this->fps = maxFps;
+    }
+
+    if (!this->openDevice()) {
+        throw std::runtime_error("Cannot open " + this->path + ": " + strerror(errno));
+    }
+}
+
+bool SerialSink::openDevice() {
+    this->descriptor = ::open(this->path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (this->descriptor < 0) {
+        this->nextOpen = steadyNanoseconds() + SERIAL_REOPEN_MS * 1000000LL;
+        return false;
+    }
+    termios settings{};
+    if (tcgetattr(this->descriptor, &settings) == 0) {
+        cfmakeraw(&settings);
+        cfsetspeed(&settings, baudConstant(this->baud));
+        settings.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(this->descriptor, TCSANOW, &settings);
+    }
+    countEvent(Counter::SerialOpens);
+    return true;
+}
+
+size_t SerialSink::frameBytes() const {
+    return this->headerSize + this->pixelCount * 3 + (this->protocol == SerialProtocol::TPM2 ? 1 : 0);
+}
+
+bool SerialSink::send(FrameBuffer* frame) {
+    if (this->descriptor < 0 && (steadyNanoseconds() < this->nextOpen || !this->openDevice())) return false;
+    const size_t payloadSize = this->pixelCount * 3;
+    iovec parts[3] = {
+        {this->header, this->headerSize},
+        {frame->data.get() + this->firstPixel * 3, payloadSize},
+        {const_cast<unsigned char*>(tpm2Footer), this->frameBytes() - this->headerSize - payloadSize},
+    };
+    if (!this->writeFully(this->descriptor, parts, 3, false)) {
+        // Unplugged, or stopping in the middle of a frame, try again later
+        this->close();
+        this->nextOpen = steadyNanoseconds() + SERIAL_REOPEN_MS * 1000000LL;
+        return false;
+    }
+    return true;
+}
+
+void SerialSink::close() {
+    if (this->descriptor >= 0) {
+        ::close(this->descriptor);
+        this->descriptor = -1;
+    }
+}
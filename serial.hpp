@@ -0,0 +1,56 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef SERIAL_HPP
+#define SERIAL_HPP
+
+#define SERIAL_DEFAULT_BAUD 115200
+// 8N1 puts a start and a stop bit around every byte
+#define SERIAL_BITS_PER_BYTE 10
+#define SERIAL_REOPEN_MS 1000
+#define ADALIGHT_HEADER_SIZE 6
+#define TPM2_HEADER_SIZE 4
+#define TPM2_FRAME_START 0xC9
+#define TPM2_DATA_FRAME 0xDA
+#define TPM2_FRAME_END 0x36
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "sink.hpp"
+
+enum class SerialProtocol {
+    Adalight,
+    TPM2
+};
+
+bool isSerialTarget(const std::string& url);
+
+// Streams frames to a USB LED controller on a tty.
+// Header, pooled frame and footer go out in one writev. The sink's rate cap defaults to what the baud rate carries,
+// so frames are not queued up in the tty buffer. A device that disappears is reopened every SERIAL_REOPEN_MS.
+class SerialSink : public Sink {
+    std::string path;
+    int baud = SERIAL_DEFAULT_BAUD;
+    SerialProtocol protocol = SerialProtocol::Adalight;
+
+    int descriptor = -1;
+    int64_t nextOpen = 0;
+    unsigned char header[ADALIGHT_HEADER_SIZE] = {};
+    size_t headerSize = 0;
+
+    bool openDevice();
+    // Bytes on the wire per frame including framing
+    size_t frameBytes() const;
+protected:
+    // serial://DEVICE[?baud=N&protocol=adalight|tpm2], opens the device
+    void configure(const OutputUrl& parsed, int width, int height) override;
+    bool send(FrameBuffer* frame) override;
+    void close() override;
+};
+
+
+
+#endif //SERIAL_HPP
@@ -0,0 +1,26 @@
+#version 430 core
+
+#define WAVEFORM_LENGTH 512
+
+uniform lowp float time;
+uniform lowp float amplitude;
+uniform lowp vec2 res;
+
+uniform int waveformHead;
+
+layout(std430, binding = 2) buffer waveform_ring {
+    vec2 waveform[WAVEFORM_LENGTH];
+};
+
+layout(location = 0) out vec4 diffuseColor;
+
+void main() {
+    // One min/max column per pixel column, newest on the right
+    int age = int(res.x) - 1 - int(gl_FragCoord.x);
+    vec2 envelope = waveform[(waveformHead - age + WAVEFORM_LENGTH) % WAVEFORM_LENGTH];
+    float y = (gl_FragCoord.y / res.y) * 2 - 1;
+
+    bool lit = y >= envelope.x && y <= envelope.y;
+    float yFraction = gl_FragCoord.y / res.y;
+    diffuseColor = vec4(lit ? 0.2 : 0, lit ? 1 : 0, lit ? yFraction : 0, 1.0);
+}
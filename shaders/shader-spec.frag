@@ -22,11 +22,7 @@ void main() {
     float xFraction = float(gl_FragCoord.x) / res.x;
     float yFraction = float(gl_FragCoord.y) / res.y;
     int binIndex = int(floor((xFraction)*LOG_BANDS));
-    float band = log2(log_bands[binIndex]*amplitude*(pow(xFraction*2+0.5, 2)))+pow(amplitude*5+1, 3);
-    band = log(log_bands[binIndex]+1)/4; // Only 
-    band = band*(xFraction+0.2*2);
-    band = band/2;
-    band = band * pow(amplitude*2+1.5, 2);
+    float band = log_bands[binIndex]; // Normalized to 0-1 by the AGC
     //bin = bin*(xFraction*2+0.5);
     //vec2 bin = log_bins[binIndex].xy;
     //lowp float magnitude = sqrt(bin.x*bin.x + bin.y*bin.y) / FRAMES_PER_BUFFER;
@@ -0,0 +1,29 @@
+#version 430 core
+
+#define LOG_BANDS 128
+
+uniform lowp float time;
+uniform lowp float amplitude;
+uniform lowp vec2 res;
+
+layout(std430, binding = 1) buffer log_fft {
+    float log_bands[LOG_BANDS];
+};
+layout(std430, binding = 3) buffer stereo_image {
+    vec4 stereo[LOG_BANDS]; // balance, mid, side, correlation
+};
+
+layout(location = 0) out vec4 diffuseColor;
+
+void main() {
+    // Bands mirrored around the center, each half scaled by how far the band leans to its side
+    float xFraction = float(gl_FragCoord.x) / res.x;
+    float side = xFraction < 0.5 ? -1 : 1;
+    int binIndex = int(floor(abs(xFraction*2 - 1)*(LOG_BANDS - 1)));
+    vec4 image = stereo[binIndex];
+
+    float band = log_bands[binIndex] * clamp(1 + side*image.x, 0, 1);
+    bool lit = gl_FragCoord.y < band*res.y;
+    float yFraction = gl_FragCoord.y / res.y;
+    diffuseColor = vec4(lit ? image.z + 0.2 : 0, lit ? yFraction : 0, lit ? image.y : 0, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 430 core
+
+#define LOG_BANDS 128
+#define HISTORY_LENGTH 256
+
+uniform lowp float time;
+uniform lowp float amplitude;
+uniform lowp vec2 res;
+
+uniform sampler2D history;
+uniform int historyHead;
+
+layout(location = 0) out vec4 diffuseColor;
+
+void main() {
+    float xFraction = float(gl_FragCoord.x) / res.x;
+    int binIndex = int(floor(xFraction*LOG_BANDS));
+    // Newest frame at the top, older frames scroll down
+    int age = int(res.y) - 1 - int(gl_FragCoord.y);
+    int row = (historyHead - age + HISTORY_LENGTH) % HISTORY_LENGTH;
+    float band = texelFetch(history, ivec2(binIndex, row), 0).r;
+
+    diffuseColor = vec4(band, band*band, band*0.2, 1.0);
+}
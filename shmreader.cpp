@@ -0,0 +1,115 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "colorcli.hpp"
+#include "metrics.hpp"
+#include "shmring.hpp"
+#include "timing.hpp"
+
+#define READER_REPORT_MS 1000
+#define READER_WAIT_MS 100
+
+struct Options {
+    std::string ring;
+    int seconds = 0;
+};
+
+static volatile sig_atomic_t running = 1;
+// Keeps the pixel loop from being optimized out
+static volatile uint64_t checksum = 0;
+
+static void intHandler(int) {
+    running = 0;
+}
+
+static Options parseOptions(const int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t separator = arg.find('=');
+        const std::string option = arg.substr(0, separator);
+        const std::string value = separator == std::string::npos ? "" : arg.substr(separator + 1);
+        if (option == "--ring") {
+            options.ring = value;
+        } else if (option == "--seconds") {
+            options.seconds = std::stoi(value);
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    if (options.ring.empty()) {
+        throw std::runtime_error("Missing --ring");
+    }
+    return options;
+}
+
+// Reference reader for the shm:// sink, the loop a local display driver would run.
+// Reports per second how many frames arrived, how many the reader skipped, how many were overwritten while
+// being read and the handoff latency from publishing to the reader waking up.
+int main(const int argc, char** argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        fprintf(stderr, "Usage: %s --ring=NAME [--seconds=N]\n", argv[0]);
+        return 1;
+    }
+
+    ShmRingReader reader;
+    try {
+        reader.open(options.ring);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    const ShmRingHeader& layout = reader.layout();
+    printf("Reading %s%ux%u%s frames from %s%u%s slots of %s\n", CLI_GREEN, layout.width, layout.height, CLI_RESET,
+        CLI_GREEN, layout.slotCount, CLI_RESET, options.ring.c_str());
+    signal(SIGINT, intHandler);
+
+    const int64_t end = options.seconds > 0 ? steadyNanoseconds() + options.seconds * 1000000000LL : INT64_MAX;
+    int64_t nextReport = steadyNanoseconds() + READER_REPORT_MS * 1000000LL;
+    auto latency = std::make_unique<Histogram>();
+    uint64_t dropped = 0;
+    uint64_t torn = 0;
+    while (running && steadyNanoseconds() < end && !reader.closed()) {
+        const unsigned char* pixels = nullptr;
+        if (const ShmSlot* slot = reader.next(READER_WAIT_MS, pixels, dropped); slot != nullptr) {
+            latency->record(steadyNanoseconds() - slot->published);
+            // Stands in for pushing the pixels to the panel
+            uint64_t sum = 0;
+            for (uint32_t i = 0; i < layout.slotSize; ++i) {
+                sum += pixels[i];
+            }
+            checksum = sum;
+            if (!reader.intact(slot)) {
+                ++torn;
+            }
+        }
+
+        if (const int64_t now = steadyNanoseconds(); now >= nextReport) {
+            printf("%s%4lu%s frames, %lu dropped, %lu torn, handoff p50 %.1f us p99 %.1f us max %.1f us\n",
+                CLI_GREEN, static_cast<unsigned long>(latency->count()), CLI_RESET,
+                static_cast<unsigned long>(dropped), static_cast<unsigned long>(torn),
+                static_cast<double>(latency->percentile(0.5)) / 1e3, static_cast<double>(latency->percentile(0.99)) / 1e3,
+                static_cast<double>(latency->max()) / 1e3);
+            latency = std::make_unique<Histogram>();
+            dropped = 0;
+            torn = 0;
+            nextReport += READER_REPORT_MS * 1000000LL;
+        }
+    }
+    if (reader.closed()) {
+        printf("%sThe writer closed the ring%s\n", CLI_YELLOW, CLI_RESET);
+    }
+    return 0;
+}
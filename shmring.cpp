@@ -0,0 +1,110 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "shmring.hpp"
+
+#include "timing.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+static uint32_t alignUp(const size_t size) {
+    return static_cast<uint32_t>((size + SHM_RING_ALIGNMENT - 1) / SHM_RING_ALIGNMENT * SHM_RING_ALIGNMENT);
+}
+
+size_t shmRingSize(const uint32_t slotCount, const uint32_t slotSize) {
+    return alignUp(sizeof(ShmRingHeader)) + static_cast<size_t>(slotCount) * alignUp(SHM_RING_ALIGNMENT + slotSize);
+}
+
+void shmRingLayout(ShmRingHeader& header, const uint32_t slotCount, const uint32_t width, const uint32_t height) {
+    header.version = SHM_RING_VERSION;
+    header.slotCount = slotCount;
+    header.slotSize = width * height * 3;
+    header.width = width;
+    header.height = height;
+    header.slotOffset = alignUp(sizeof(ShmRingHeader));
+    header.slotStride = alignUp(SHM_RING_ALIGNMENT + header.slotSize);
+}
+
+void shmFutexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void shmFutexWait(std::atomic<uint32_t>& word, const uint32_t expected, const int timeoutMs) {
+    const timespec timeout{timeoutMs / 1000, timeoutMs % 1000 * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+ShmRingReader::~ShmRingReader() {
+    this->close();
+}
+
+void ShmRingReader::open(const std::string& name) {
+    const std::string path = name.starts_with("/") ? name : "/" + name;
+    const int descriptor = shm_open(path.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (descriptor < 0) {
+        throw std::runtime_error("Cannot open shared memory " + path + ": " + strerror(errno));
+    }
+    struct stat status{};
+    fstat(descriptor, &status);
+    this->size = static_cast<size_t>(status.st_size);
+    void* memory = this->size >= sizeof(ShmRingHeader) ? mmap(nullptr, this->size, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+    ::close(descriptor);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Cannot map shared memory " + path);
+    }
+    this->header = static_cast<const ShmRingHeader*>(memory);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->header->magic != SHM_RING_MAGIC || this->header->version != SHM_RING_VERSION
+        || this->size < shmRingSize(this->header->slotCount, this->header->slotSize)) {
+        this->close();
+        throw std::runtime_error(path + " is not a version " + std::to_string(SHM_RING_VERSION) + " frame ring");
+    }
+    this->last = 0;
+}
+
+void ShmRingReader::close() {
+    if (this->header != nullptr) {
+        munmap(const_cast<ShmRingHeader*>(this->header), this->size);
+        this->header = nullptr;
+    }
+}
+
+const ShmSlot* ShmRingReader::next(const int timeoutMs, const unsigned char*& pixels, uint64_t& dropped) {
+    auto& futex = const_cast<std::atomic<uint32_t>&>(this->header->futex);
+    const int64_t deadline = steadyNanoseconds() + timeoutMs * 1000000LL;
+    while (true) {
+        const uint64_t newest = this->header->written.load(std::memory_order_acquire);
+        if (newest > this->last) {
+            const ShmSlot* slot = shmRingSlot(this->header, newest);
+            // Already being overwritten by a newer frame, take that one instead
+            if (slot->sequence.load(std::memory_order_acquire) != newest) continue;
+            if (this->last > 0) {
+                dropped += newest - this->last - 1;
+            }
+            this->last = newest;
+            pixels = shmRingPixels(slot);
+            return slot;
+        }
+        const int64_t remaining = deadline - steadyNanoseconds();
+        if (remaining <= 0 || this->closed()) return nullptr;
+        shmFutexWait(futex, static_cast<uint32_t>(newest), static_cast<int>(remaining / 1000000) + 1);
+    }
+}
+
+bool ShmRingReader::intact(const ShmSlot* slot) const {
+    // Orders the reads of the pixels before the sequence check, the seqlock pattern
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->sequence.load(std::memory_order_relaxed) == this->last;
+}
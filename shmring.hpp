@@ -0,0 +1,92 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef SHMRING_HPP
+#define SHMRING_HPP
+
+#define SHM_RING_MAGIC 0x31524D53 // "SMR1"
+#define SHM_RING_VERSION 1
+#define SHM_RING_DEFAULT_SLOTS 4
+#define SHM_RING_MAX_SLOTS 64
+// Slots start on their own cache lines so the writer of one never invalidates the header a reader polls
+#define SHM_RING_ALIGNMENT 64
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Layout of a POSIX shared-memory frame ring, shared by the shm:// sink and local display drivers.
+// One writer fills the slots round robin, any number of readers map the object read only. A slot's sequence is 0
+// while it is being written and the frame's sequence once it is complete, a reader that sees the same sequence
+// before and after using the pixels knows they were not overwritten meanwhile.
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    // Pixel bytes per slot, the frame is width x height RGB
+    uint32_t slotSize;
+    uint32_t width;
+    uint32_t height;
+    // Offset of the first slot and distance between slots
+    uint32_t slotOffset;
+    uint32_t slotStride;
+    // Sequence of the newest complete frame, 0 before the first one
+    std::atomic<uint64_t> written;
+    // Low 32 bits of written, readers FUTEX_WAIT on it. The writer wakes unconditionally, a waiter count would
+    // need readers to map the ring writable and saves less than a microsecond per frame.
+    std::atomic<uint32_t> futex;
+    // Set when the writer exits, the name is unlinked and no more frames will come
+    std::atomic<uint32_t> closed;
+};
+
+struct ShmSlot {
+    std::atomic<uint64_t> sequence;
+    // steady_clock nanoseconds the frame was published, comparable across processes on the same machine
+    int64_t published;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+
+// Bytes of the shared memory object for slotCount slots of slotSize pixel bytes
+size_t shmRingSize(uint32_t slotCount, uint32_t slotSize);
+// Fills in the header fields that describe the layout
+void shmRingLayout(ShmRingHeader& header, uint32_t slotCount, uint32_t width, uint32_t height);
+inline ShmSlot* shmRingSlot(const ShmRingHeader* header, const uint64_t sequence) {
+    const auto* base = reinterpret_cast<const unsigned char*>(header) + header->slotOffset;
+    return reinterpret_cast<ShmSlot*>(const_cast<unsigned char*>(base) + (sequence % header->slotCount) * header->slotStride);
+}
+inline const unsigned char* shmRingPixels(const ShmSlot* slot) {
+    return reinterpret_cast<const unsigned char*>(slot) + SHM_RING_ALIGNMENT;
+}
+
+// Shared futex, the ring lives in memory mapped by several processes
+void shmFutexWake(std::atomic<uint32_t>& word);
+// Returns after a wake, when word no longer holds expected or after timeoutMs
+void shmFutexWait(std::atomic<uint32_t>& word, uint32_t expected, int timeoutMs);
+
+// Reference reader: maps a ring read only and hands out frames in place, no copy
+class ShmRingReader {
+    const ShmRingHeader* header = nullptr;
+    size_t size = 0;
+    uint64_t last = 0;
+public:
+    ~ShmRingReader();
+    // Maps /dev/shm/NAME, throws when it is missing or not a ring of this version
+    void open(const std::string& name);
+    void close();
+
+    // Waits up to timeoutMs for a frame newer than the last one returned and points pixels at it in the ring.
+    // Skips to the newest frame when the reader fell behind, the skipped count goes to dropped.
+    // Returns the frame's slot, nullptr on timeout.
+    const ShmSlot* next(int timeoutMs, const unsigned char*& pixels, uint64_t& dropped);
+    // True while slot still holds the frame next() returned, check after using its pixels
+    bool intact(const ShmSlot* slot) const;
+    bool closed() const { return this->header->closed.load(std::memory_order_acquire) != 0; }
+    const ShmRingHeader& layout() const { return *this->header; }
+};
+
+
+
+#endif //SHMRING_HPP
@@ -0,0 +1,130 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "shmsink.hpp"
+
+#include "timing.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+bool isShmTarget(const std::string& url) {
+    return url.starts_with("shm://");
+}
+
+int ShmSink::create() const {
+    int descriptor = shm_open(this->path.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (descriptor < 0 && errno == EEXIST) {
+        // Left behind unless its writer still holds the lock, a crashed writer's lock went with its process
+        const int existing = shm_open(this->path.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (existing >= 0 && flock(existing, LOCK_EX | LOCK_NB) != 0) {
+            ::close(existing);
+            throw std::runtime_error("Shared memory " + this->path + " is in use by another running writer: " + this->url);
+        }
+        if (existing >= 0) {
+            shm_unlink(this->path.c_str());
+            ::close(existing);
+        }
+        descriptor = shm_open(this->path.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    }
+    if (descriptor < 0) {
+        throw std::runtime_error("Cannot create shared memory " + this->path + ": " + strerror(errno));
+    }
+    flock(descriptor, LOCK_EX | LOCK_NB);
+    return descriptor;
+}
+
+bool ShmSink::ownsName() const {
+    const int named = shm_open(this->path.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (named < 0) return false;
+    struct stat ours{};
+    struct stat current{};
+    const bool same = fstat(this->descriptor, &ours) == 0 && fstat(named, &current) == 0
+        && ours.st_dev == current.st_dev && ours.st_ino == current.st_ino;
+    ::close(named);
+    return same;
+}
+
+void ShmSink::configure(const OutputUrl& parsed, const int width, const int height) {
+    if (parsed.address.empty() || parsed.address.find('/') != std::string::npos) {
+        throw std::runtime_error("Shared memory names are a single path component: " + this->url);
+    }
+    this->path = "/" + parsed.address;
+    uint32_t slots = SHM_RING_DEFAULT_SLOTS;
+    for (const auto& [key, value] : parsed.parameters) {
+        if (key == "slots") {
+            slots = static_cast<uint32_t>(std::clamp(parseParameter(this->url, key, value), 2, SHM_RING_MAX_SLOTS));
+        } else {
+            throw std::runtime_error("Unknown parameter " + key + " in " + this->url);
+        }
+    }
+    const bool wholeCanvas = this->pixelCount == static_cast<size_t>(width) * height;
+    const uint32_t ringWidth = wholeCanvas ? width : static_cast<uint32_t>(this->pixelCount);
+    const uint32_t ringHeight = wholeCanvas ? height : 1;
+
+    // Always a new object, resizing a stale one in place would SIGBUS readers still mapping its old size
+    this->descriptor = this->create();
+    this->size = shmRingSize(slots, ringWidth * ringHeight * 3);
+    void* memory = ftruncate(this->descriptor, static_cast<off_t>(this->size)) == 0
+        ? mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, this->descriptor, 0) : MAP_FAILED;
+    if (memory == MAP_FAILED) {
+        const int error = errno;
+        shm_unlink(this->path.c_str());
+        ::close(this->descriptor);
+        this->descriptor = -1;
+        throw std::runtime_error("Cannot map shared memory " + this->path + ": " + strerror(error));
+    }
+    // Also faults every page in, publishing must not page fault
+    std::memset(memory, 0, this->size);
+    this->header = static_cast<ShmRingHeader*>(memory);
+    shmRingLayout(*this->header, slots, ringWidth, ringHeight);
+    // Readers check the magic first, it goes in after the rest of the layout
+    std::atomic_thread_fence(std::memory_order_release);
+    this->header->magic = SHM_RING_MAGIC;
+}
+
+bool ShmSink::send(FrameBuffer* frame) {
+    const uint64_t sequence = this->sequence;
+    ShmSlot* slot = shmRingSlot(this->header, sequence);
+    // Readers still on the frame slotCount back see the slot change under them
+    slot->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(const_cast<unsigned char*>(shmRingPixels(slot)), frame->data.get() + this->firstPixel * 3, this->pixelCount * 3);
+    slot->published = steadyNanoseconds();
+    slot->sequence.store(sequence, std::memory_order_release);
+
+    this->header->written.store(sequence, std::memory_order_release);
+    this->header->futex.store(static_cast<uint32_t>(sequence), std::memory_order_release);
+    shmFutexWake(this->header->futex);
+    return true;
+}
+
+void ShmSink::close() {
+    if (this->header == nullptr) return;
+    this->header->closed.store(1, std::memory_order_release);
+    this->header->futex.fetch_add(1, std::memory_order_release);
+    shmFutexWake(this->header->futex);
+    munmap(this->header, this->size);
+    this->header = nullptr;
+    // The name may have been removed by hand and taken by another writer since
+    if (this->ownsName()) {
+        shm_unlink(this->path.c_str());
+    }
+    // Releases the lock
+    ::close(this->descriptor);
+    this->descriptor = -1;
+}
+
+ShmSink::~ShmSink() {
+    // A sink that never ran, close() is a no-op after a regular stop
+    this->close();
+}
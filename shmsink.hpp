@@ -0,0 +1,44 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef SHMSINK_HPP
+#define SHMSINK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "shmring.hpp"
+#include "sink.hpp"
+
+bool isShmTarget(const std::string& url);
+
+// Hands frames to a display driver on the same machine through a shared-memory frame ring (shmring.hpp).
+// Publishing is one copy of the pixel range into the next slot and a futex wake, a few microseconds instead of
+// a trip through the TCP stack. The ring is created at startup and unlinked at exit, or when the sink is destroyed
+// without ever running because startup failed.
+// The writer holds an flock on the ring as long as it runs. A ring without one was left behind by a crash and is
+// replaced, one with a live writer makes startup fail instead of taking the name from it.
+class ShmSink : public Sink {
+    std::string path;
+    int descriptor = -1;
+    ShmRingHeader* header = nullptr;
+    size_t size = 0;
+
+    // Creates the object under path and locks it, throws when another writer holds it
+    int create() const;
+    // Whether path still names the object this sink created
+    bool ownsName() const;
+protected:
+    // shm://NAME[?slots=N], NAME appears as /dev/shm/NAME. A pixel range is a count x 1 frame.
+    void configure(const OutputUrl& parsed, int width, int height) override;
+    bool send(FrameBuffer* frame) override;
+    void close() override;
+public:
+    ~ShmSink() override;
+};
+
+
+
+#endif //SHMSINK_HPP
@@ -0,0 +1,132 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// GCC/Clang vector extensions, lowered to SSE on x86 and NEON on ARM
+typedef float float4 __attribute__((vector_size(16)));
+
+inline float4 loadFloat4(const float* src) {
+    float4 v;
+    std::memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+inline void storeFloat4(float* dst, const float4 v) {
+    std::memcpy(dst, &v, sizeof(v));
+}
+
+inline float4 min4(const float4 a, const float4 b) {
+    return a < b ? a : b;
+}
+
+inline float4 max4(const float4 a, const float4 b) {
+    return a > b ? a : b;
+}
+
+// Min and max of count samples, count has to be a multiple of 4
+inline void minMax(const float* samples, const int count, float& min, float& max) {
+    float4 lo = loadFloat4(samples);
+    float4 hi = lo;
+    for (int i = 4; i < count; i += 4) {
+        const float4 v = loadFloat4(samples + i);
+        lo = min4(lo, v);
+        hi = max4(hi, v);
+    }
+    min = std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3]));
+    max = std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3]));
+}
+
+#if defined(__clang__)
+#define SHUFFLE4(a, b, i0, i1, i2, i3) __builtin_shufflevector(a, b, i0, i1, i2, i3)
+#else
+typedef int int4 __attribute__((vector_size(16)));
+#define SHUFFLE4(a, b, i0, i1, i2, i3) __builtin_shuffle(a, b, int4{i0, i1, i2, i3})
+#endif
+
+// Splits interleaved frames into one contiguous block of frames samples per channel.
+// Stereo and quad inputs are shuffled four frames at a time, frames has to be a multiple of 4
+inline void deinterleave(const float* interleaved, float* planar, const int channels, const int frames) {
+    if (channels == 1) {
+        std::memcpy(planar, interleaved, sizeof(float) * frames);
+    } else if (channels == 2) {
+        for (int i = 0; i < frames; i += 4) {
+            const float4 a = loadFloat4(interleaved + i*2);
+            const float4 b = loadFloat4(interleaved + i*2 + 4);
+            storeFloat4(planar + i, SHUFFLE4(a, b, 0, 2, 4, 6));
+            storeFloat4(planar + frames + i, SHUFFLE4(a, b, 1, 3, 5, 7));
+        }
+    } else if (channels == 4) {
+        for (int i = 0; i < frames; i += 4) {
+            const float4 f0 = loadFloat4(interleaved + i*4);
+            const float4 f1 = loadFloat4(interleaved + i*4 + 4);
+            const float4 f2 = loadFloat4(interleaved + i*4 + 8);
+            const float4 f3 = loadFloat4(interleaved + i*4 + 12);
+            const float4 lo01 = SHUFFLE4(f0, f1, 0, 4, 1, 5);
+            const float4 hi01 = SHUFFLE4(f0, f1, 2, 6, 3, 7);
+            const float4 lo23 = SHUFFLE4(f2, f3, 0, 4, 1, 5);
+            const float4 hi23 = SHUFFLE4(f2, f3, 2, 6, 3, 7);
+            storeFloat4(planar + i, SHUFFLE4(lo01, lo23, 0, 1, 4, 5));
+            storeFloat4(planar + frames + i, SHUFFLE4(lo01, lo23, 2, 3, 6, 7));
+            storeFloat4(planar + frames*2 + i, SHUFFLE4(hi01, hi23, 0, 1, 4, 5));
+            storeFloat4(planar + frames*3 + i, SHUFFLE4(hi01, hi23, 2, 3, 6, 7));
+        }
+    } else {
+        for (int i = 0; i < frames; ++i) {
+            for (int channel = 0; channel < channels; ++channel) {
+                planar[channel*frames + i] = interleaved[i*channels + channel];
+            }
+        }
+    }
+}
+
+typedef unsigned char uchar16 __attribute__((vector_size(16)));
+typedef unsigned long long ulong2 __attribute__((vector_size(16)));
+
+inline uchar16 loadBytes16(const unsigned char* src) {
+    uchar16 v;
+    std::memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+inline void storeBytes16(unsigned char* dst, const uchar16 v) {
+    std::memcpy(dst, &v, sizeof(v));
+}
+
+inline bool isZero16(const uchar16 v) {
+    const ulong2 words = reinterpret_cast<ulong2>(v);
+    return (words[0] | words[1]) == 0;
+}
+
+// out = a ^ b over size bytes, 16 at a time
+inline void xorBytes(const unsigned char* a, const unsigned char* b, unsigned char* out, const size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        storeBytes16(out + i, loadBytes16(a + i) ^ loadBytes16(b + i));
+    }
+    for (; i < size; ++i) {
+        out[i] = a[i] ^ b[i];
+    }
+}
+
+// Number of leading zero bytes in data, at most size, checked 16 at a time
+inline size_t zeroPrefix(const unsigned char* data, const size_t size) {
+    size_t i = 0;
+    while (i + 16 <= size && isZero16(loadBytes16(data + i))) {
+        i += 16;
+    }
+    while (i < size && data[i] == 0) {
+        ++i;
+    }
+    return i;
+}
+
+
+
+#endif //SIMD_HPP
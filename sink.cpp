@@ -0,0 +1,224 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "sink.hpp"
+
+#include "alloctrack.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+OutputUrl Sink::parseUrl(const std::string& url, const int width, const int height, SinkParameters& common) {
+    OutputUrl parsed = parseOutputUrl(url);
+    std::vector<std::pair<std::string, std::string>> own;
+    size_t count = 0;
+    for (const auto& [key, value] : parsed.parameters) {
+        if (key == "start") {
+            common.firstPixel = parseParameter(url, key, value);
+        } else if (key == "count") {
+            count = parseParameter(url, key, value);
+        } else if (key == "fps") {
+            common.fps = parseParameter(url, key, value);
+        } else if (key == "queue") {
+            common.queue = std::clamp(parseParameter(url, key, value), 1, SINK_MAX_QUEUE);
+        } else {
+            own.emplace_back(key, value);
+        }
+    }
+    parsed.parameters = std::move(own);
+
+    const size_t canvasPixels = static_cast<size_t>(width) * height;
+    common.pixelCount = count > 0 ? count : canvasPixels - std::min(common.firstPixel, canvasPixels);
+    if (common.firstPixel >= canvasPixels || common.firstPixel + common.pixelCount > canvasPixels) {
+        throw std::runtime_error("Output pixels start=" + std::to_string(common.firstPixel) + " count=" + std::to_string(count)
+            + " do not fit the canvas of " + std::to_string(canvasPixels) + " pixels: " + url);
+    }
+    return parsed;
+}
+
+void Sink::init(const std::string& url, const int width, const int height) {
+    this->url = url;
+    SinkParameters common;
+    const OutputUrl parsed = parseUrl(url, width, height, common);
+    this->firstPixel = common.firstPixel;
+    this->pixelCount = common.pixelCount;
+    this->fps = common.fps;
+    this->queueCapacity = common.queue;
+    this->configure(parsed, width, height);
+    this->period = this->fps > 0 ? 1000000000LL / this->fps : 0;
+    this->metrics = &registerSink(this->url);
+}
+
+void Sink::start() {
+    this->running = true;
+    this->thread = std::thread(&Sink::run, this);
+}
+
+void Sink::stop() {
+    if (!this->thread.joinable()) return;
+    {
+        std::lock_guard lock(this->mutex);
+        this->running = false;
+    }
+    this->wake.notify_all();
+    this->room.notify_all();
+    this->thread.join();
+}
+
+bool Sink::takeSlot(const int64_t now) {
+    if (this->period == 0) return true;
+    // A frame up to a quarter period early still counts, so render jitter does not skip frames of a sink capped at the render rate
+    if (now < this->nextFrame - this->period / 4) return false;
+    // Stay on the grid unless the frames fell more than a period behind it
+    this->nextFrame = (now - this->nextFrame > this->period ? now : this->nextFrame) + this->period;
+    return true;
+}
+
+FrameBuffer* Sink::enqueue(FrameBuffer* frame, const int64_t now) {
+    FrameBuffer* dropped = nullptr;
+    if (this->queued == this->queueCapacity) {
+        dropped = this->queue[this->head];
+        this->head = (this->head + 1) % this->queueCapacity;
+        --this->queued;
+    }
+    const int tail = (this->head + this->queued) % this->queueCapacity;
+    this->queue[tail] = frame;
+    this->queuedAt[tail] = now;
+    this->sequences[tail] = ++this->submitted;
+    ++this->queued;
+    return dropped;
+}
+
+void Sink::submit(FrameBuffer* frame, const int64_t now) {
+    frame->retain();
+    FrameBuffer* dropped = nullptr;
+    // A frame that is too early replaces the deferred one, one that is on time supersedes it
+    FrameBuffer* skipped;
+    {
+        std::lock_guard lock(this->mutex);
+        skipped = this->deferred;
+        this->deferred = nullptr;
+        if (this->takeSlot(now)) {
+            dropped = this->enqueue(frame, steadyNanoseconds());
+        } else {
+            this->deferred = frame;
+        }
+    }
+    // Also wakes the sink thread to wait for the deferred frame's slot
+    this->wake.notify_one();
+    if (skipped != nullptr) {
+        skipped->release();
+        this->metrics->rateLimited.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (dropped != nullptr) {
+        dropped->release();
+        this->metrics->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Sink::waitForRoom() {
+    std::unique_lock lock(this->mutex);
+    this->room.wait_for(lock, std::chrono::milliseconds(SINK_POLL_MS), [this] {
+        return this->queued < this->queueCapacity || !this->running;
+    });
+}
+
+void Sink::run() {
+    const char* name = this->metrics->name.c_str();
+    registerRealtimeThread(name);
+    traceThread(name);
+    this->open();
+
+    std::unique_lock lock(this->mutex);
+    while (true) {
+        this->wake.wait(lock, [this] { return this->queued > 0 || this->deferred != nullptr || !this->running; });
+        if (!this->running) break;
+        if (this->queued == 0) {
+            // Nothing newer came in time, the deferred frame goes out in its slot
+            const int64_t slot = this->nextFrame - this->period / 4;
+            this->wake.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(slot)), [this] {
+                return this->queued > 0 || this->deferred == nullptr || !this->running;
+            });
+            if (!this->running) break;
+            if (this->queued == 0) {
+                if (this->deferred == nullptr || !this->takeSlot(steadyNanoseconds())) continue;
+                this->enqueue(this->deferred, steadyNanoseconds());
+                this->deferred = nullptr;
+            }
+        }
+        FrameBuffer* frame = this->queue[this->head];
+        const int64_t queuedAt = this->queuedAt[this->head];
+        this->sequence = this->sequences[this->head];
+        this->head = (this->head + 1) % this->queueCapacity;
+        --this->queued;
+        lock.unlock();
+        this->room.notify_one();
+
+        const int64_t start = steadyNanoseconds();
+        const bool sent = this->send(frame);
+        const int64_t end = steadyNanoseconds();
+        frame->release();
+        if (sent) {
+            this->metrics->latency.record(end - queuedAt);
+            this->metrics->sent.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            this->metrics->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        traceEvent(name, start, end);
+        lock.lock();
+    }
+    for (; this->queued > 0; --this->queued) {
+        this->queue[this->head]->release();
+        this->head = (this->head + 1) % this->queueCapacity;
+    }
+    if (this->deferred != nullptr) {
+        this->deferred->release();
+        this->deferred = nullptr;
+    }
+    lock.unlock();
+    this->close();
+}
+
+bool Sink::writeFully(const int descriptor, iovec* parts, int count, const bool socket) {
+    while (count > 0) {
+        ssize_t result;
+        if (socket) {
+            msghdr message{};
+            message.msg_iov = parts;
+            message.msg_iovlen = count;
+            result = sendmsg(descriptor, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } else {
+            result = writev(descriptor, parts, count);
+        }
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            pollfd waiting{descriptor, POLLOUT, 0};
+            poll(&waiting, 1, SINK_POLL_MS);
+            if (!this->running) return false;
+            continue;
+        }
+        // Skip what is out and continue in the middle of the part that is not
+        auto written = static_cast<size_t>(result);
+        while (count > 0 && written >= parts->iov_len) {
+            written -= parts->iov_len;
+            ++parts;
+            --count;
+        }
+        if (count > 0) {
+            parts->iov_base = static_cast<unsigned char*>(parts->iov_base) + written;
+            parts->iov_len -= written;
+        }
+    }
+    return true;
+}
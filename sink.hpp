@@ -0,0 +1,115 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef SINK_HPP
+#define SINK_HPP
+
+// Frames waiting for a sink, one keeps the latency at a frame when the sink falls behind
+#define SINK_DEFAULT_QUEUE 1
+#define SINK_MAX_QUEUE 8
+// How long a sink blocked on its device waits before checking whether it should stop
+#define SINK_POLL_MS 100
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "framepool.hpp"
+#include "metrics.hpp"
+#include "output.hpp"
+
+// One output fed from the rendered frames on its own thread.
+// The render thread only takes a reference on the pooled frame and queues it, every sink reads its pixel range
+// straight out of the shared buffer. A full queue drops its oldest frame, so a slow or stuck sink loses frames
+// on its own instead of holding up the render loop or the other sinks.
+class Sink {
+    SinkMetrics* metrics = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable room;
+    FrameBuffer* queue[SINK_MAX_QUEUE] = {};
+    int64_t queuedAt[SINK_MAX_QUEUE] = {};
+    uint64_t sequences[SINK_MAX_QUEUE] = {};
+    uint64_t submitted = 0;
+    int queueCapacity = SINK_DEFAULT_QUEUE;
+    int head = 0;
+    int queued = 0;
+    bool busy = false;
+
+    int64_t period = 0;
+    int64_t nextFrame = 0;
+    // Newest frame that came too early for the rate cap, sent in the next slot unless a newer one replaces it
+    FrameBuffer* deferred = nullptr;
+
+    void run();
+    // With the mutex held: whether a frame at now is on the rate cap's grid, advances the grid if it is
+    bool takeSlot(int64_t now);
+    // With the mutex held: appends frame, returns the oldest one when the queue was full
+    FrameBuffer* enqueue(FrameBuffer* frame, int64_t now);
+protected:
+    // What every sink's URL may say besides the sink's own parameters
+    struct SinkParameters {
+        size_t firstPixel = 0;
+        size_t pixelCount = 0;
+        int fps = 0;
+        int queue = SINK_DEFAULT_QUEUE;
+    };
+
+    // Name of the sink, its URL unless configure() says otherwise
+    std::string url;
+    size_t firstPixel = 0;
+    size_t pixelCount = 0;
+    // 0 takes every frame, sinks with a physical limit set their own default in configure()
+    int fps = 0;
+    // Of the frame send() gets, from 1 on. Frames dropped from the queue leave a gap, so receivers see them.
+    uint64_t sequence = 0;
+    std::atomic<bool> running = false;
+
+    // Reads the sink's own parameters, everything but start, count, fps and queue. Throws on errors.
+    virtual void configure(const OutputUrl& parsed, int width, int height) = 0;
+    // Called on the sink thread before the first and after the last frame
+    virtual void open() {}
+    virtual void close() {}
+    // Sends the pixel range of frame on the sink thread, false drops it. May block, but has to notice running
+    // going false within SINK_POLL_MS.
+    virtual bool send(FrameBuffer* frame) = 0;
+    // Pool buffers the sink keeps beyond the queued frame it is sending
+    virtual int extraBuffers() const { return 0; }
+
+    // Writes parts completely to a non-blocking descriptor, waiting for it to take more as long as the sink runs.
+    // Sockets get sendmsg so a closed peer is an error instead of SIGPIPE. False on errors and on stop.
+    bool writeFully(int descriptor, iovec* parts, int count, bool socket);
+
+    // Parses url for a width x height canvas, takes start, count, fps and queue out of its parameters. Throws on errors.
+    static OutputUrl parseUrl(const std::string& url, int width, int height, SinkParameters& common);
+public:
+    virtual ~Sink() = default;
+
+    // Parses url for a width x height canvas and registers the sink's metrics, throws on errors
+    void init(const std::string& url, int width, int height);
+    void start();
+    void stop();
+
+    // Render thread: queues a reference on frame, or holds it for the next slot when the rate cap says it is too early
+    void submit(FrameBuffer* frame, int64_t now);
+    // Blocks until the sink has room for another frame, for the unpaced render loop.
+    // Gives up after SINK_POLL_MS, so a stuck sink slows the loop down but does not stop it.
+    void waitForRoom();
+
+    const std::string& name() const { return this->url; }
+    int maxFps() const { return this->fps; }
+    // Pool buffers the sink can hold at once, queued, sending, deferred and its own
+    int buffers() const { return this->queueCapacity + 1 + (this->period > 0 ? 1 : 0) + this->extraBuffers(); }
+};
+
+
+
+#endif //SINK_HPP
@@ -0,0 +1,183 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "source.hpp"
+
+#include "audio.hpp"
+#include "colorcli.hpp"
+#include "timing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+void PortAudioSource::init() {
+    
+    if (const PaError err = Pa_Initialize(); err != paNoError) {
+        throw std::runtime_error("Cannot initialize PortAudio: " + std::to_string(err));
+    }
+
+    const int numDevices = Pa_GetDeviceCount();
+    if (numDevices < 0) {
+        Pa_Terminate();
+        throw std::runtime_error("Cannot get Device Count.");
+    }
+    std::vector<PaDeviceIndex> inputDevices;
+    for (int i = 0; i < numDevices; i++) {
+        if (const PaDeviceInfo *deviceInfo = Pa_GetDeviceInfo(i); deviceInfo->maxInputChannels > 0) {
+            inputDevices.push_back(i);
+        }
+    }
+
+    printf("Found %s%zd%s devices: \n", CLI_RED, inputDevices.size(), CLI_RESET);
+    for (size_t i = 0; i < inputDevices.size(); i++) {
+        const PaDeviceIndex devIndex = inputDevices[i];
+        printf(CLI_BLUE "%zd%s: %s%s%s\n", i+1, CLI_RESET, CLI_YELLOW, Pa_GetDeviceInfo(devIndex)->name, CLI_RESET);
+    }
+    printf("Select Device Numer: ");
+    int selectedDeviceNr;
+    std::cin >> selectedDeviceNr;
+
+    this->deviceIndex = inputDevices[selectedDeviceNr-1];
+
+    const PaDeviceInfo *deviceInfo = Pa_GetDeviceInfo(this->deviceIndex);
+    printf("Selected Device %d: %s\n", selectedDeviceNr, deviceInfo->name);
+}
+
+void PortAudioSource::start(const int maxChannels) {
+    const PaDeviceInfo *deviceInfo = Pa_GetDeviceInfo(this->deviceIndex);
+    
+    PaStreamParameters inputParameters;
+    inputParameters.device = this->deviceIndex;
+    this->channelCount = std::min(deviceInfo->maxInputChannels, maxChannels);
+    inputParameters.channelCount = this->channelCount;
+    inputParameters.sampleFormat = paFloat32;
+    inputParameters.suggestedLatency = deviceInfo->defaultLowInputLatency;
+    inputParameters.hostApiSpecificStreamInfo = nullptr;
+
+    this->rate = deviceInfo->defaultSampleRate;
+    
+    if (const PaError err = Pa_OpenStream(&this->stream, &inputParameters, nullptr,
+            this->rate, FRAMES_PER_BUFFER, paClipOff,
+        nullptr, nullptr); err != paNoError) {
+        throw std::runtime_error("Cannot open Audio Stream: " + std::to_string(err));
+    }
+
+    if (const PaError err = Pa_StartStream(this->stream); err != paNoError) {
+        this->stop();
+        throw std::runtime_error("Cannot start Audio Stream: " + std::to_string(err));
+    }
+
+    this->inputLatency = Pa_GetStreamInfo(this->stream)->inputLatency;
+    this->framesRead = 0;
+    this->anchored = false;
+}
+
+int64_t PortAudioSource::read(float* interleaved) {
+    if (const PaError err = Pa_ReadStream(this->stream, interleaved, FRAMES_PER_BUFFER)) {
+        this->stop();
+        throw std::runtime_error("Cannot read Audio Stream: " + std::to_string(err));
+    }
+
+    // Stream time at which the first frame of this block reached the converter,
+    // mapped onto steady_clock through a pair of readings taken back to back
+    const PaTime streamNow = Pa_GetStreamTime(this->stream);
+    const int64_t steadyNow = steadyNanoseconds();
+    const long available = std::max(Pa_GetStreamReadAvailable(this->stream), 0L);
+    const PaTime blockTime = streamNow - this->inputLatency - static_cast<PaTime>(available + FRAMES_PER_BUFFER) / this->rate;
+    const int64_t measured = steadyNow - static_cast<int64_t>((streamNow - blockTime) * 1e9);
+
+    const int64_t predicted = this->anchorTime + static_cast<int64_t>((this->framesRead - this->anchorFrame) * 1000000000ULL / this->rate);
+    if (!this->anchored || std::abs(measured - predicted) > CAPTURE_RESYNC_NS) {
+        // First block or an overflow, restart the timeline
+        this->anchorTime = measured;
+        this->anchorFrame = this->framesRead;
+        this->anchored = true;
+    } else {
+        this->anchorTime += (measured - predicted) / CAPTURE_SLEW;
+    }
+
+    const int64_t captureTime = this->anchorTime + static_cast<int64_t>((this->framesRead - this->anchorFrame) * 1000000000ULL / this->rate);
+    this->framesRead += FRAMES_PER_BUFFER;
+    return captureTime;
+}
+
+void PortAudioSource::stop() {
+    if (const PaError err = Pa_StopStream(this->stream); err != paNoError) {
+        throw std::runtime_error("Cannot stop Audio Stream: " + std::to_string(err));
+    }
+    if (const PaError err = Pa_CloseStream(this->stream); err != paNoError) {
+        throw std::runtime_error("Cannot close Audio Stream: " + std::to_string(err));
+    }
+    Pa_Terminate();
+}
+
+SyntheticSource::SyntheticSource(const int channels, const int sampleRate) {
+    this->channelCount = channels;
+    this->rate = sampleRate;
+}
+
+void SyntheticSource::start(const int maxChannels) {
+    this->channelCount = std::min(this->channelCount, maxChannels);
+    this->nextBlock = std::chrono::steady_clock::now();
+}
+
+int64_t SyntheticSource::read(float* interleaved) {
+    const int64_t captureTime = std::chrono::duration_cast<std::chrono::nanoseconds>(this->nextBlock.time_since_epoch()).count();
+    this->nextBlock += std::chrono::nanoseconds(1000000000LL * FRAMES_PER_BUFFER / this->rate);
+    std::this_thread::sleep_until(this->nextBlock);
+
+    for (int i = 0; i < FRAMES_PER_BUFFER; ++i, ++this->frame) {
+        const float seconds = static_cast<float>(this->frame % (this->rate * 8)) / static_cast<float>(this->rate);
+        // Exponential sweep from 40 Hz to ~10 kHz every 8 seconds
+        const float phase = 2 * static_cast<float>(M_PI) * 40 * (std::exp2(seconds) - 1) / std::log(2.0f);
+        const float tone = 0.3f * std::sin(phase);
+        for (int channel = 0; channel < this->channelCount; ++channel) {
+            this->noise = this->noise * 1664525u + 1013904223u;
+            const float white = static_cast<float>(this->noise >> 8) / static_cast<float>(1 << 24) - 0.5f;
+            interleaved[i*this->channelCount + channel] = tone * (channel % 2 ? 0.5f : 1.0f) + 0.05f * white;
+        }
+    }
+    return captureTime;
+}
+
+ClickSource::ClickSource(const int channels, const int sampleRate) {
+    this->channelCount = channels;
+    this->rate = sampleRate;
+}
+
+void ClickSource::start(const int maxChannels) {
+    this->channelCount = std::min(this->channelCount, maxChannels);
+    this->nextBlock = std::chrono::steady_clock::now();
+}
+
+int64_t ClickSource::read(float* interleaved) {
+    const int64_t captureTime = std::chrono::duration_cast<std::chrono::nanoseconds>(this->nextBlock.time_since_epoch()).count();
+    this->nextBlock += std::chrono::nanoseconds(1000000000LL * FRAMES_PER_BUFFER / this->rate);
+    std::this_thread::sleep_until(this->nextBlock);
+
+    // Round the interval to whole blocks so every burst starts a block
+    const uint64_t interval = (static_cast<uint64_t>(this->rate) * CLICK_INTERVAL_MS / 1000 / FRAMES_PER_BUFFER) * FRAMES_PER_BUFFER;
+    const uint64_t length = static_cast<uint64_t>(this->rate) * CLICK_LENGTH_MS / 1000;
+
+    const bool onset = this->frame % interval == 0;
+    for (int i = 0; i < FRAMES_PER_BUFFER; ++i, ++this->frame) {
+        const uint64_t position = this->frame % interval;
+        const float sample = position < length
+            ? 0.8f * std::sin(2 * static_cast<float>(M_PI) * CLICK_FREQUENCY * static_cast<float>(position) / static_cast<float>(this->rate))
+            : 0.0f;
+        for (int channel = 0; channel < this->channelCount; ++channel) {
+            interleaved[i*this->channelCount + channel] = sample;
+        }
+    }
+
+    if (onset) {
+        this->lastClickTime = captureTime;
+        ++this->clicks;
+    }
+    return captureTime;
+}
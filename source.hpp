@@ -0,0 +1,86 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#define CLICK_INTERVAL_MS 300
+#define CLICK_LENGTH_MS 30
+#define CLICK_FREQUENCY 1000
+#define CAPTURE_RESYNC_NS 5000000
+#define CAPTURE_SLEW 64
+
+#include <portaudio.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Delivers blocks of FRAMES_PER_BUFFER interleaved float frames to the analysis thread
+class AudioSource {
+protected:
+    int channelCount = 1;
+    int rate = 0;
+public:
+    virtual ~AudioSource() = default;
+
+    // Called on the main thread before the audio thread exists
+    virtual void init() = 0;
+    virtual void start(int maxChannels) = 0;
+    // Blocks until the next block is available, returns the steady_clock nanoseconds
+    // at which its first frame was captured
+    virtual int64_t read(float* interleaved) = 0;
+    virtual void stop() = 0;
+
+    int channels() const { return this->channelCount; }
+    int sampleRate() const { return this->rate; }
+};
+
+// Capture times follow the sample clock, anchored to the stream time and slowly slewed towards it
+class PortAudioSource final : public AudioSource {
+    PaDeviceIndex deviceIndex = paNoDevice;
+    PaStream *stream = nullptr;
+    PaTime inputLatency = 0;
+    uint64_t framesRead = 0;
+    int64_t anchorTime = 0;
+    uint64_t anchorFrame = 0;
+    bool anchored = false;
+public:
+    void init() override;
+    void start(int maxChannels) override;
+    int64_t read(float* interleaved) override;
+    void stop() override;
+};
+
+// Sine sweep over quiet white noise, paced like a real device
+class SyntheticSource final : public AudioSource {
+    std::chrono::steady_clock::time_point nextBlock;
+    uint64_t frame = 0;
+    uint32_t noise = 1;
+public:
+    explicit SyntheticSource(int channels = 2, int sampleRate = 48000);
+
+    void init() override {}
+    void start(int maxChannels) override;
+    int64_t read(float* interleaved) override;
+    void stop() override {}
+};
+
+// Silence with a tone burst every CLICK_INTERVAL_MS, used to measure audio-to-pixel latency.
+// Bursts start on a block boundary and are stamped with that block's capture time.
+class ClickSource final : public AudioSource {
+    std::chrono::steady_clock::time_point nextBlock;
+    uint64_t frame = 0;
+public:
+    explicit ClickSource(int channels = 1, int sampleRate = 48000);
+
+    void init() override {}
+    void start(int maxChannels) override;
+    int64_t read(float* interleaved) override;
+    void stop() override {}
+
+    std::atomic<int64_t> lastClickTime = 0;
+    std::atomic<uint64_t> clicks = 0;
+};
+
+#endif //SOURCE_HPP
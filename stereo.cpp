@@ -0,0 +1,48 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "stereo.hpp"
+
+#include <cmath>
+
+void StereoImage::init(const int bands, const float blockRate) {
+    this->smoothing = std::exp(-1.0f / (STEREO_SMOOTHING_SECONDS * blockRate));
+    this->features.resize(bands * 4);
+    for (int band = 0; band < bands; ++band) {
+        float *feature = &this->features[band * 4];
+        feature[0] = 0;
+        feature[1] = 1;
+        feature[2] = 0;
+        feature[3] = 1;
+    }
+}
+
+void StereoImage::process(const fftwf_complex* left, const fftwf_complex* right, const int* bandStart, const int* bandEnd) {
+    const int bands = static_cast<int>(this->features.size() / 4);
+    for (int band = 0; band < bands; ++band) {
+        float leftEnergy = 0, rightEnergy = 0, cross = 0;
+        for (int i = bandStart[band]; i < bandEnd[band]; ++i) {
+            leftEnergy += left[i][0]*left[i][0] + left[i][1]*left[i][1];
+            rightEnergy += right[i][0]*right[i][0] + right[i][1]*right[i][1];
+            cross += left[i][0]*right[i][0] + left[i][1]*right[i][1];
+        }
+
+        const float total = leftEnergy + rightEnergy;
+        if (total <= 0) continue;
+
+        // |M|^2 = (|L|^2 + |R|^2 + 2Re(L R*)) / 4 and |S|^2 = (|L|^2 + |R|^2 - 2Re(L R*)) / 4
+        const float mid = (total + 2*cross) / (2*total);
+        const float target[4] = {
+            (rightEnergy - leftEnergy) / total,
+            mid,
+            1 - mid,
+            cross / std::sqrt(leftEnergy * rightEnergy + 1e-20f)
+        };
+
+        float *feature = &this->features[band * 4];
+        for (int j = 0; j < 4; ++j) {
+            feature[j] = this->smoothing * feature[j] + (1 - this->smoothing) * target[j];
+        }
+    }
+}
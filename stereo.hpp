@@ -0,0 +1,27 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef STEREO_HPP
+#define STEREO_HPP
+
+#define STEREO_SMOOTHING_SECONDS 0.05f
+
+#include <fftw3.h>
+#include <vector>
+
+// Per-band stereo features of two spectra, published as
+// (balance -1..1, mid share 0..1, side share 0..1, correlation -1..1)
+class StereoImage {
+    float smoothing = 0;
+    std::vector<float> features;
+public:
+    void init(int bands, float blockRate);
+    void process(const fftwf_complex* left, const fftwf_complex* right, const int* bandStart, const int* bandEnd);
+
+    const std::vector<float>& result() const { return this->features; }
+};
+
+
+
+#endif //STEREO_HPP
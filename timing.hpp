@@ -0,0 +1,23 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef TIMING_HPP
+#define TIMING_HPP
+
+#include <chrono>
+#include <cstdint>
+
+// Timestamps passed between threads are steady_clock nanoseconds
+inline int64_t steadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Timestamps leaving the machine are system_clock nanoseconds, the receiver's clock is synced to it at best
+inline int64_t wallNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+
+#endif //TIMING_HPP
@@ -0,0 +1,134 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "trace.hpp"
+
+#include "colorcli.hpp"
+#include "timing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+struct TraceEvent {
+    const char* name;
+    int64_t start;
+    int64_t end;
+};
+
+// Written by its owning thread only, the dump reads up to the published count
+struct TraceBuffer {
+    std::atomic<const char*> name = nullptr;
+    std::atomic<uint64_t> written = 0;
+    TraceEvent events[TRACE_EVENTS_PER_THREAD];
+};
+
+namespace trace_detail {
+    std::atomic<bool> enabled = false;
+}
+
+static std::unique_ptr<TraceBuffer[]> buffers;
+static std::atomic<int> claimedBuffers = 0;
+static thread_local TraceBuffer* threadBuffer = nullptr;
+static thread_local const char* threadName = nullptr;
+
+static std::string tracePath;
+static int64_t traceStart = 0;
+static std::thread dumpThread;
+static std::atomic<bool> dumping = false;
+// Lock-free, so setting it from a signal handler is safe
+static std::atomic<bool> dumpRequested = false;
+
+static TraceBuffer* claimBuffer() {
+    const int index = claimedBuffers.fetch_add(1, std::memory_order_relaxed);
+    if (index >= TRACE_MAX_THREADS) return nullptr;
+    TraceBuffer* buffer = &buffers[index];
+    buffer->name = threadName;
+    return buffer;
+}
+
+void traceThread(const char* name) {
+    threadName = name;
+    if (threadBuffer != nullptr) {
+        threadBuffer->name = name;
+    }
+}
+
+void traceEvent(const char* name, const int64_t start, const int64_t end) {
+    if (!tracingEnabled()) return;
+    if (threadBuffer == nullptr) {
+        threadBuffer = claimBuffer();
+        // Out of rings, the thread stays untraced
+        if (threadBuffer == nullptr) return;
+    }
+    const uint64_t index = threadBuffer->written.load(std::memory_order_relaxed);
+    threadBuffer->events[index % TRACE_EVENTS_PER_THREAD] = {name, start, end};
+    threadBuffer->written.store(index + 1, std::memory_order_release);
+}
+
+static void writeTrace() {
+    FILE* file = fopen(tracePath.c_str(), "w");
+    if (file == nullptr) {
+        printf("%sCannot write trace to %s%s\n", CLI_RED, tracePath.c_str(), CLI_RESET);
+        return;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    uint64_t total = 0;
+    const int threads = std::min(claimedBuffers.load(), TRACE_MAX_THREADS);
+    for (int thread = 0; thread < threads; ++thread) {
+        const TraceBuffer& buffer = buffers[thread];
+        char numberedName[32];
+        snprintf(numberedName, sizeof(numberedName), "thread %d", thread);
+        const char* name = buffer.name.load();
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", thread, name != nullptr ? name : numberedName);
+        first = false;
+
+        const uint64_t written = buffer.written.load(std::memory_order_acquire);
+        const uint64_t oldest = written > TRACE_EVENTS_PER_THREAD - TRACE_GUARD ? written - (TRACE_EVENTS_PER_THREAD - TRACE_GUARD) : 0;
+        for (uint64_t index = oldest; index < written; ++index) {
+            const TraceEvent& event = buffer.events[index % TRACE_EVENTS_PER_THREAD];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, thread, static_cast<double>(event.start - traceStart) / 1e3,
+                static_cast<double>(event.end - event.start) / 1e3);
+        }
+        total += written - oldest;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    printf("Wrote %s%lu%s trace events to %s\n", CLI_GREEN, static_cast<unsigned long>(total), CLI_RESET, tracePath.c_str());
+}
+
+static void runDumps() {
+    while (dumping) {
+        if (dumpRequested.exchange(false)) {
+            writeTrace();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_POLL_MS));
+    }
+}
+
+void startTracing(const std::string& path) {
+    tracePath = path;
+    buffers = std::make_unique<TraceBuffer[]>(TRACE_MAX_THREADS);
+    traceStart = steadyNanoseconds();
+    dumping = true;
+    dumpThread = std::thread(runDumps);
+    trace_detail::enabled = true;
+}
+
+void stopTracing() {
+    if (!trace_detail::enabled) return;
+    trace_detail::enabled = false;
+    dumping = false;
+    dumpThread.join();
+    writeTrace();
+}
+
+void requestTraceDump() {
+    dumpRequested = true;
+}
@@ -0,0 +1,40 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#define TRACE_MAX_THREADS 16
+#define TRACE_EVENTS_PER_THREAD (1 << 16)
+// Events this close to being overwritten are left out of a dump taken while the thread keeps writing
+#define TRACE_GUARD 256
+#define TRACE_POLL_MS 100
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace trace_detail {
+    extern std::atomic<bool> enabled;
+}
+
+// Records into preallocated per-thread rings, a disabled tracer costs one relaxed load per event
+inline bool tracingEnabled() {
+    return trace_detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Allocates the rings and starts a thread that writes Chrome trace JSON to path on request and at stop
+void startTracing(const std::string& path);
+void stopTracing();
+// Async-signal-safe, the dump happens on the tracer's own thread
+void requestTraceDump();
+
+// Names the calling thread in the timeline, threads that never call this get a numbered name
+void traceThread(const char* name);
+// name must be a string literal or otherwise outlive the tracer
+void traceEvent(const char* name, int64_t start, int64_t end);
+
+
+
+#endif //TRACE_HPP
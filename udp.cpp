@@ -0,0 +1,325 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "udp.hpp"
+
+#include "metrics.hpp"
+#include "output.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+// Room for the largest header, every packet owns one slot in UdpSink::headers
+#define UDP_HEADER_SLOT 128
+
+static const unsigned char padding[1] = {0};
+
+static void writeBigEndian16(unsigned char* at, const uint16_t value) {
+    at[0] = static_cast<unsigned char>(value >> 8);
+    at[1] = static_cast<unsigned char>(value);
+}
+
+static void writeBigEndian32(unsigned char* at, const uint32_t value) {
+    writeBigEndian16(at, static_cast<uint16_t>(value >> 16));
+    writeBigEndian16(at + 2, static_cast<uint16_t>(value));
+}
+
+static sockaddr_in resolve(const std::string& host, const int port) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    if (const int error = getaddrinfo(host.c_str(), nullptr, &hints, &result); error != 0) {
+        throw std::runtime_error("Cannot resolve " + host + ": " + gai_strerror(error));
+    }
+    sockaddr_in address = *reinterpret_cast<sockaddr_in*>(result->ai_addr);
+    freeaddrinfo(result);
+    address.sin_port = htons(port);
+    return address;
+}
+
+// 239.255.UHI.ULO, E1.31 section 9.3.1
+static sockaddr_in sacnMulticastAddress(const int universe) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(SACN_PORT);
+    address.sin_addr.s_addr = htonl(0xEFFF0000u | static_cast<uint32_t>(universe & 0xFFFF));
+    return address;
+}
+
+bool isUdpTarget(const std::string& url) {
+    return url.starts_with("ddp://") || url.starts_with("sacn://") || url.starts_with("artnet://") || url.starts_with("wled://");
+}
+
+UdpSink::Target UdpSink::parseTarget(const OutputUrl& parsed, const std::string& url) const {
+    Target target;
+    const std::string& scheme = parsed.scheme;
+    int port;
+    if (scheme == "ddp") {
+        target.protocol = UdpProtocol::DDP;
+        port = DDP_PORT;
+    } else if (scheme == "sacn") {
+        target.protocol = UdpProtocol::SACN;
+        target.universe = 1;
+        port = SACN_PORT;
+    } else if (scheme == "artnet") {
+        target.protocol = UdpProtocol::ArtNet;
+        port = ARTNET_PORT;
+    } else if (scheme == "wled") {
+        target.protocol = UdpProtocol::WLED;
+        port = WLED_PORT;
+    } else {
+        throw std::runtime_error("Unknown output protocol: " + scheme);
+    }
+
+    if (parsed.port > 0) {
+        port = parsed.port;
+    }
+
+    for (const auto& [key, value] : parsed.parameters) {
+        if (key == "universe" && (target.protocol == UdpProtocol::SACN || target.protocol == UdpProtocol::ArtNet)) {
+            target.universe = parseParameter(url, key, value);
+        } else if (key == "timeout" && target.protocol == UdpProtocol::WLED) {
+            target.timeout = std::clamp(parseParameter(url, key, value), 1, 255);
+        } else {
+            throw std::runtime_error("Unknown parameter " + key + " in " + url);
+        }
+    }
+    if (target.protocol == UdpProtocol::SACN && (target.universe < 1 || target.universe > 63999)) {
+        throw std::runtime_error("sACN universes are 1 to 63999: " + url);
+    }
+    if (target.protocol == UdpProtocol::ArtNet && (target.universe < 0 || target.universe > 0x7FFF)) {
+        throw std::runtime_error("Art-Net universes are 0 to 32767: " + url);
+    }
+
+    if (parsed.host.empty()) {
+        if (target.protocol != UdpProtocol::SACN) {
+            throw std::runtime_error("Missing host in " + url);
+        }
+        target.multicastUniverses = true;
+    } else {
+        target.address = resolve(parsed.host, port);
+    }
+    return target;
+}
+
+void UdpSink::configure(const OutputUrl& parsed, const int width, const int height) {
+    std::vector<std::vector<Packet>> targetPackets;
+    std::vector<std::vector<sockaddr_in>> targetAddresses;
+    for (size_t i = 0; i < this->targetUrls.size(); ++i) {
+        const std::string& url = this->targetUrls[i];
+        Target target;
+        if (i == 0) {
+            target = this->parseTarget(parsed, url);
+            target.firstPixel = this->firstPixel;
+            target.pixelCount = this->pixelCount;
+        } else {
+            // The group shares fps and queue, only the pixel range differs
+            SinkParameters common;
+            target = this->parseTarget(parseUrl(url, width, height, common), url);
+            target.firstPixel = common.firstPixel;
+            target.pixelCount = common.pixelCount;
+            this->url += " " + url;
+        }
+        targetAddresses.emplace_back();
+        targetPackets.push_back(this->addPackets(target, targetAddresses.back()));
+    }
+
+    // Round robin over the controllers, so every batch spreads across them and none gets a burst of a whole frame
+    for (size_t index = 0, added = 1; added > 0; ++index) {
+        added = 0;
+        for (size_t target = 0; target < targetPackets.size(); ++target) {
+            if (index < targetPackets[target].size()) {
+                this->packets.push_back(targetPackets[target][index]);
+                this->addresses.push_back(targetAddresses[target][index]);
+                ++added;
+            }
+        }
+    }
+
+    const size_t count = this->packets.size();
+    this->iovecs.resize(count * 3);
+    this->messages.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Packet& packet = this->packets[i];
+        iovec* iov = &this->iovecs[i * 3];
+        iov[0].iov_base = &this->headers[packet.header];
+        iov[0].iov_len = packet.headerSize;
+        iov[1].iov_len = packet.payloadSize;
+        iov[2].iov_base = const_cast<unsigned char*>(padding);
+        iov[2].iov_len = packet.padded ? 1 : 0;
+        msghdr& header = this->messages[i].msg_hdr;
+        header = {};
+        header.msg_name = &this->addresses[i];
+        header.msg_namelen = sizeof(sockaddr_in);
+        header.msg_iov = iov;
+        header.msg_iovlen = packet.padded ? 3 : 2;
+    }
+
+    this->socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (this->socket < 0) {
+        throw std::runtime_error(std::string("Cannot open UDP socket: ") + strerror(errno));
+    }
+    constexpr int enable = 1;
+    constexpr unsigned char ttl = UDP_MULTICAST_TTL;
+    // Art-Net is commonly sent to the subnet broadcast address
+    setsockopt(this->socket, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+    setsockopt(this->socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+}
+
+// Payload bytes per packet, WLED fixtures that fit into one DRGB packet are sent as such
+static size_t chunkSize(const UdpProtocol protocol, const size_t rangeSize) {
+    switch (protocol) {
+        case UdpProtocol::DDP: return DDP_MAX_PAYLOAD;
+        case UdpProtocol::WLED: return rangeSize <= WLED_DRGB_PIXELS * 3 ? WLED_DRGB_PIXELS * 3 : WLED_DNRGB_PIXELS * 3;
+        default: return DMX_PIXEL_CHANNELS;
+    }
+}
+
+static size_t headerSize(const UdpProtocol protocol, const size_t rangeSize) {
+    switch (protocol) {
+        case UdpProtocol::DDP: return DDP_HEADER_SIZE;
+        case UdpProtocol::SACN: return SACN_HEADER_SIZE;
+        case UdpProtocol::ArtNet: return ARTNET_HEADER_SIZE;
+        case UdpProtocol::WLED: return rangeSize <= WLED_DRGB_PIXELS * 3 ? 2 : 4;
+    }
+    return 0;
+}
+
+std::vector<UdpSink::Packet> UdpSink::addPackets(const Target& target, std::vector<sockaddr_in>& packetAddresses) {
+    const size_t rangeOffset = target.firstPixel * 3;
+    const size_t rangeSize = target.pixelCount * 3;
+    const size_t chunk = chunkSize(target.protocol, rangeSize);
+
+    std::random_device random;
+    unsigned char cid[16];
+    for (unsigned char& byte : cid) byte = static_cast<unsigned char>(random());
+
+    std::vector<Packet> targetPackets;
+    for (size_t offset = 0, index = 0; offset < rangeSize; offset += chunk, ++index) {
+        Packet packet{target.protocol, this->headers.size(), headerSize(target.protocol, rangeSize),
+            rangeOffset + offset, std::min(chunk, rangeSize - offset), false};
+        this->headers.resize(packet.header + UDP_HEADER_SLOT);
+        unsigned char* header = &this->headers[packet.header];
+        sockaddr_in address = target.address;
+
+        const int universe = target.universe + static_cast<int>(index);
+        switch (target.protocol) {
+            case UdpProtocol::DDP: {
+                // Version 1, PUSH on the last packet makes the controller show the frame
+                const bool last = offset + chunk >= rangeSize;
+                header[0] = 0x40 | (last ? 0x01 : 0x00);
+                header[2] = 0x0B; // RGB, 8 bits per channel
+                header[3] = 0x01; // Default output device
+                writeBigEndian32(header + 4, static_cast<uint32_t>(offset));
+                writeBigEndian16(header + 8, static_cast<uint16_t>(packet.payloadSize));
+                break;
+            }
+            case UdpProtocol::SACN: {
+                const uint16_t slots = static_cast<uint16_t>(packet.payloadSize);
+                const uint16_t length = SACN_HEADER_SIZE + slots;
+                writeBigEndian16(header, 0x0010);
+                std::memcpy(header + 4, "ASC-E1.17\0\0\0", 12);
+                writeBigEndian16(header + 16, 0x7000 | (length - 16));
+                writeBigEndian32(header + 18, 0x00000004);
+                std::memcpy(header + 22, cid, sizeof(cid));
+                writeBigEndian16(header + 38, 0x7000 | (length - 38));
+                writeBigEndian32(header + 40, 0x00000002);
+                std::strncpy(reinterpret_cast<char*>(header + 44), "visualizer", 64);
+                header[108] = 100; // Default priority
+                writeBigEndian16(header + 113, static_cast<uint16_t>(universe));
+                writeBigEndian16(header + 115, 0x7000 | (length - 115));
+                header[117] = 0x02;
+                header[118] = 0xA1;
+                writeBigEndian16(header + 121, 1);
+                writeBigEndian16(header + 123, slots + 1);
+                if (target.multicastUniverses) {
+                    address = sacnMulticastAddress(universe);
+                }
+                break;
+            }
+            case UdpProtocol::ArtNet: {
+                std::memcpy(header, "Art-Net\0", 8);
+                header[8] = 0x00; // OpDmx, little endian
+                header[9] = 0x50;
+                writeBigEndian16(header + 10, 14);
+                header[14] = static_cast<unsigned char>(universe & 0xFF);
+                header[15] = static_cast<unsigned char>(universe >> 8 & 0x7F);
+                packet.padded = packet.payloadSize % 2 != 0;
+                writeBigEndian16(header + 16, static_cast<uint16_t>(packet.payloadSize + (packet.padded ? 1 : 0)));
+                break;
+            }
+            case UdpProtocol::WLED: {
+                header[0] = packet.headerSize == 2 ? WLED_DRGB : WLED_DNRGB;
+                header[1] = static_cast<unsigned char>(target.timeout);
+                if (packet.headerSize == 4) {
+                    writeBigEndian16(header + 2, static_cast<uint16_t>(offset / 3));
+                }
+                break;
+            }
+        }
+        targetPackets.push_back(packet);
+        packetAddresses.push_back(address);
+    }
+    return targetPackets;
+}
+
+bool UdpSink::send(FrameBuffer* frame) {
+    ++this->packetSequence;
+    for (size_t i = 0; i < this->packets.size(); ++i) {
+        const Packet& packet = this->packets[i];
+        unsigned char* header = &this->headers[packet.header];
+        switch (packet.protocol) {
+            case UdpProtocol::DDP: header[1] = static_cast<unsigned char>(this->packetSequence % 15 + 1); break;
+            case UdpProtocol::SACN: header[111] = static_cast<unsigned char>(this->packetSequence); break;
+            // 0 would disable sequence checking on the controller
+            case UdpProtocol::ArtNet: header[12] = static_cast<unsigned char>(this->packetSequence % 255 + 1); break;
+            case UdpProtocol::WLED: break;
+        }
+        this->iovecs[i * 3 + 1].iov_base = frame->data.get() + packet.payloadOffset;
+    }
+
+    bool complete = true;
+    for (size_t sent = 0; sent < this->messages.size();) {
+        if (sent > 0 && this->paceMicroseconds > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(this->paceMicroseconds));
+        }
+        const unsigned int batch = static_cast<unsigned int>(std::min<size_t>(UDP_BATCH_PACKETS, this->messages.size() - sent));
+        const int result = sendmmsg(this->socket, &this->messages[sent], batch, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd waiting{this->socket, POLLOUT, 0};
+                poll(&waiting, 1, SINK_POLL_MS);
+                if (!this->running) return false;
+                continue;
+            }
+            // sendmmsg fails on the first packet it could not send, an unreachable controller only loses that one
+            countEvent(Counter::UdpSendErrors);
+            complete = false;
+            ++sent;
+            continue;
+        }
+        countEvent(Counter::UdpPackets, result);
+        sent += static_cast<size_t>(std::max(result, 1));
+    }
+    return complete;
+}
+
+void UdpSink::close() {
+    if (this->socket >= 0) {
+        ::close(this->socket);
+        this->socket = -1;
+    }
+}
@@ -0,0 +1,108 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef UDP_HPP
+#define UDP_HPP
+
+#define DDP_PORT 4048
+#define DDP_HEADER_SIZE 10
+// 480 RGB pixels, keeps packets below a 1500 byte MTU
+#define DDP_MAX_PAYLOAD 1440
+#define SACN_PORT 5568
+#define SACN_HEADER_SIZE 126
+#define ARTNET_PORT 6454
+#define ARTNET_HEADER_SIZE 18
+// 170 RGB pixels per DMX universe, the last two slots stay unused
+#define DMX_PIXEL_CHANNELS 510
+#define WLED_PORT 21324
+#define WLED_DRGB 2
+#define WLED_DNRGB 4
+// DRGB holds up to 490 pixels in one packet, larger fixtures get DNRGB chunks with a start index
+#define WLED_DRGB_PIXELS 490
+#define WLED_DNRGB_PIXELS 489
+// Seconds without packets after which WLED returns to its own effects
+#define WLED_TIMEOUT_SECONDS 2
+// Packets handed to one sendmmsg call
+#define UDP_BATCH_PACKETS 32
+#define UDP_MULTICAST_TTL 4
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sink.hpp"
+
+enum class UdpProtocol {
+    DDP,
+    SACN,
+    ArtNet,
+    WLED
+};
+
+bool isUdpTarget(const std::string& url);
+
+// Packetizes RGB frames for a group of LED controllers that share one sender thread and socket.
+// Packet headers are built once, every frame only updates sequence numbers and points the payload iovecs into the frame,
+// so the pixels go from the pooled readback buffer to the socket without a copy. The controllers' packets are
+// interleaved and sent in sendmmsg batches of UDP_BATCH_PACKETS, so adding a fixture adds packets to the batches
+// instead of syscalls, optionally paced to keep the controllers' buffers from overflowing. A send is non-blocking,
+// an unreachable controller only loses its own packets.
+// sACN without a host sends every universe to its standard multicast group.
+class UdpSink : public Sink {
+    struct Packet {
+        UdpProtocol protocol;
+        size_t header;
+        size_t headerSize;
+        size_t payloadOffset;
+        size_t payloadSize;
+        // Art-Net wants an even number of channels
+        bool padded;
+    };
+
+    // One controller, from one URL of the group
+    struct Target {
+        UdpProtocol protocol = UdpProtocol::DDP;
+        sockaddr_in address{};
+        bool multicastUniverses = false;
+        int universe = 0;
+        int timeout = WLED_TIMEOUT_SECONDS;
+        size_t firstPixel = 0;
+        size_t pixelCount = 0;
+    };
+
+    std::vector<std::string> targetUrls;
+    int paceMicroseconds = 0;
+
+    int socket = -1;
+    std::vector<Packet> packets;
+    std::vector<unsigned char> headers;
+    std::vector<sockaddr_in> addresses;
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> messages;
+    // Frames this sink put on the wire, the protocols' own sequence numbers count it. Unlike Sink::sequence it has
+    // no gaps for frames dropped from the queue, the controllers only care about reordering.
+    uint32_t packetSequence = 0;
+
+    Target parseTarget(const OutputUrl& parsed, const std::string& url) const;
+    // The target's packets, in pixel order
+    std::vector<Packet> addPackets(const Target& target, std::vector<sockaddr_in>& packetAddresses);
+protected:
+    // ddp://HOST[:PORT], sacn://[HOST][:PORT][?universe=N], artnet://HOST[:PORT][?universe=N] or wled://HOST[:PORT][?timeout=S]
+    void configure(const OutputUrl& parsed, int width, int height) override;
+    bool send(FrameBuffer* frame) override;
+    void close() override;
+public:
+    // Sends to every one of urls, which share their rate cap and queue. The sink is initialized with the first one.
+    UdpSink(const int paceMicroseconds, std::vector<std::string> urls)
+        : targetUrls(std::move(urls)), paceMicroseconds(paceMicroseconds) {}
+};
+
+
+
+#endif //UDP_HPP
@@ -0,0 +1,75 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "wirestats.hpp"
+
+#include "codec.hpp"
+#include "colorcli.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+WireStats::WireStats() : captureLatency(std::make_unique<Histogram>()), renderLatency(std::make_unique<Histogram>()) {}
+
+void WireStats::add(const unsigned char* message, const size_t size, const int64_t received) {
+    WireHeader header;
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, message, sizeof(header));
+    }
+    if (size < sizeof(header) || header.magic != WIRE_MAGIC || header.version != WIRE_VERSION) {
+        ++this->unframed;
+        return;
+    }
+    ++this->received;
+
+    if (!this->started || header.sequence > this->highest) {
+        if (this->started) {
+            this->lost += header.sequence - this->highest - 1;
+        }
+        this->highest = header.sequence;
+        this->started = true;
+    } else {
+        // Late or duplicated, a late frame fills the gap it was counted in
+        ++this->reordered;
+        if (this->lost > 0) --this->lost;
+    }
+
+    if (header.captureTime > 0) {
+        this->captureLatency->record(std::max<int64_t>(0, received - header.captureTime));
+    }
+    this->renderLatency->record(std::max<int64_t>(0, received - header.renderTime));
+    // Transit time differences cancel the clock offset between sender and receiver, RFC 3550 section 6.4.1
+    const int64_t transit = received - header.renderTime;
+    if (this->hasTransit) {
+        const double difference = static_cast<double>(std::llabs(transit - this->previousTransit));
+        this->jitter += (difference - this->jitter) / WIRE_JITTER_GAIN;
+    }
+    this->previousTransit = transit;
+    this->hasTransit = true;
+}
+
+void WireStats::report() {
+    const uint64_t expected = this->received + this->lost;
+    const double lostPercent = expected > 0 ? 100.0 * static_cast<double>(this->lost) / static_cast<double>(expected) : 0.0;
+    printf("%s%4lu%s frames, %s%.2f%%%s lost (%lu), %lu reordered, jitter %.3f ms, capture to receive p50 %.2f ms p99 %.2f ms,"
+        " render to receive p50 %.2f ms p99 %.2f ms",
+        CLI_GREEN, static_cast<unsigned long>(this->received), CLI_RESET,
+        this->lost > 0 ? CLI_RED : CLI_GREEN, lostPercent, CLI_RESET, static_cast<unsigned long>(this->lost),
+        static_cast<unsigned long>(this->reordered), this->jitter / 1e6,
+        static_cast<double>(this->captureLatency->percentile(0.5)) / 1e6, static_cast<double>(this->captureLatency->percentile(0.99)) / 1e6,
+        static_cast<double>(this->renderLatency->percentile(0.5)) / 1e6, static_cast<double>(this->renderLatency->percentile(0.99)) / 1e6);
+    if (this->unframed > 0) {
+        printf(", %s%lu without header%s", CLI_YELLOW, static_cast<unsigned long>(this->unframed), CLI_RESET);
+    }
+    printf("\n");
+
+    this->received = 0;
+    this->lost = 0;
+    this->reordered = 0;
+    this->unframed = 0;
+    this->captureLatency = std::make_unique<Histogram>();
+    this->renderLatency = std::make_unique<Histogram>();
+}
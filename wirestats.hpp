@@ -0,0 +1,44 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef WIRESTATS_HPP
+#define WIRESTATS_HPP
+
+// Smoothing of the interarrival jitter estimate, as in RFC 3550
+#define WIRE_JITTER_GAIN 16
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "metrics.hpp"
+
+// A receiver's view of the frames coming in, taken from their wire headers: sequence gaps and reordering,
+// interarrival jitter against the render times and one-way latency. Fed and reported on the receiving thread.
+class WireStats {
+    bool started = false;
+    uint32_t highest = 0;
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    uint64_t reordered = 0;
+    // Plain RGB messages without a header
+    uint64_t unframed = 0;
+
+    bool hasTransit = false;
+    int64_t previousTransit = 0;
+    double jitter = 0;
+    std::unique_ptr<Histogram> captureLatency;
+    std::unique_ptr<Histogram> renderLatency;
+public:
+    WireStats();
+
+    // received is the wall clock nanoseconds the message arrived at
+    void add(const unsigned char* message, size_t size, int64_t received);
+    // Prints the frames since the last report on one line and starts the next interval, the jitter carries over
+    void report();
+};
+
+
+
+#endif //WIRESTATS_HPP
@@ -0,0 +1,147 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#include "zmqsink.hpp"
+
+#include "metrics.hpp"
+#include "timing.hpp"
+
+#include <zmq.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+
+bool isZmqTarget(const std::string& url) {
+    return url.starts_with("tcp://") || url.starts_with("ipc://") || url.starts_with("inproc://");
+}
+
+void ZmqSink::configure(const OutputUrl& parsed, const int width, const int height) {
+    this->endpoint = parsed.scheme + "://" + parsed.address;
+    for (const auto& [key, value] : parsed.parameters) {
+        if (key == "wire" && (value == "auto" || value == "raw")) {
+            this->negotiate = value == "auto";
+        } else {
+            throw std::runtime_error("Unknown parameter " + key + " in " + this->url);
+        }
+    }
+    const bool wholeCanvas = this->pixelCount == static_cast<size_t>(width) * height;
+    this->encoder.init(wholeCanvas ? width : static_cast<int>(this->pixelCount), wholeCanvas ? height : 1);
+    this->encodedPool.init(ZMQ_ENCODED_BUFFERS, maxEncodedSize(this->pixelCount));
+}
+
+void ZmqSink::open() {
+    this->socket = zmq_socket(this->context, ZMQ_REQ);
+    // Blocking calls return now and then so the sink notices when it should stop
+    constexpr int timeout = SINK_POLL_MS;
+    constexpr int linger = 0;
+    zmq_setsockopt(this->socket, ZMQ_SNDTIMEO, &timeout, sizeof(timeout));
+    zmq_setsockopt(this->socket, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+    zmq_setsockopt(this->socket, ZMQ_LINGER, &linger, sizeof(linger));
+    const int res = zmq_connect(this->socket, this->endpoint.c_str());
+    printf("ZeroMQ %s: %d\n", this->endpoint.c_str(), res);
+}
+
+void ZmqSink::reopen() {
+    zmq_close(this->socket);
+    if (this->inFlight != nullptr) {
+        this->inFlight->release();
+        this->inFlight = nullptr;
+    }
+    this->open();
+    // The new connection may reach a matrix that lost our last frame
+    this->encoder.requestKeyframe();
+}
+
+void ZmqSink::close() {
+    zmq_close(this->socket);
+    this->socket = nullptr;
+    if (this->inFlight != nullptr) {
+        this->inFlight->release();
+        this->inFlight = nullptr;
+    }
+    if (this->reference != nullptr) {
+        this->reference->release();
+        this->reference = nullptr;
+    }
+}
+
+bool ZmqSink::send(FrameBuffer* frame) {
+    FrameBuffer* message = frame;
+    unsigned char* data = frame->data.get() + this->firstPixel * 3;
+    size_t size = this->pixelCount * 3;
+    if (this->encodeFrames) {
+        FrameBuffer* encoded = this->encodedPool.acquire();
+        if (encoded == nullptr) {
+            countEvent(Counter::PoolExhausted);
+            return false;
+        }
+        {
+            StageTimer timer(Stage::Encode);
+            // Timestamps leave the machine, so they go out on the wall clock
+            const int64_t wallOffset = wallNanoseconds() - steadyNanoseconds();
+            const WireFrameInfo info{static_cast<uint32_t>(this->sequence),
+                frame->captureTime > 0 ? frame->captureTime + wallOffset : 0, frame->renderTime + wallOffset};
+            size = this->encoder.encode(data, encoded->data.get(), info);
+        }
+        if (this->encoder.lastWasKeyframe()) {
+            countEvent(Counter::Keyframes);
+        }
+        frame->retain();
+        if (this->reference != nullptr) {
+            this->reference->release();
+        }
+        this->reference = frame;
+        message = encoded;
+        data = encoded->data.get();
+    } else {
+        message->retain();
+    }
+    countEvent(Counter::WireBytes, size);
+
+    // A constant message, without a free function libzmq neither copies the pixels nor allocates for them.
+    // REP only replies once it has the whole message, so the buffer is ours again when the reply is in.
+    zmq_msg_t zmqMessage;
+    zmq_msg_init_data(&zmqMessage, data, size, nullptr, nullptr);
+    {
+        StageTimer timer(Stage::Send);
+        while (zmq_msg_send(&zmqMessage, this->socket, 0) < 0) {
+            // Signals like the trace dump's SIGUSR1 may land on this thread
+            const int error = zmq_errno();
+            if ((error != EAGAIN && error != EINTR) || !this->running) {
+                zmq_msg_close(&zmqMessage);
+                message->release();
+                // The matrix never saw this delta
+                this->encoder.requestKeyframe();
+                return false;
+            }
+        }
+    }
+    this->inFlight = message;
+    int replySize;
+    {
+        StageTimer timer(Stage::Reply);
+        while ((replySize = zmq_recv(this->socket, this->reply, sizeof(this->reply), 0)) < 0) {
+            // Without a reply the message may still be on its way, close() releases it after the socket
+            if (!this->running) return false;
+            const int error = zmq_errno();
+            if (error != EAGAIN && error != EINTR) {
+                // The REQ socket would wait for this reply forever and refuse every later frame
+                this->reopen();
+                return false;
+            }
+        }
+    }
+    this->inFlight->release();
+    this->inFlight = nullptr;
+    // Encode as long as the receiver says it decodes, a legacy matrix replies empty
+    if (this->negotiate) {
+        const bool decodes = replySize >= 1 && (this->reply[0] & WIRE_REPLY_ENCODED);
+        if (decodes && (!this->encodeFrames || (this->reply[0] & WIRE_REPLY_KEYFRAME))) {
+            this->encoder.requestKeyframe();
+        }
+        this->encodeFrames = decodes;
+    }
+    return true;
+}
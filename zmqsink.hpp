@@ -0,0 +1,53 @@
+//
+// Created by felix on 19.10.26.
+//
+
+#ifndef ZMQSINK_HPP
+#define ZMQSINK_HPP
+
+// A message is not encoded before the previous one was answered
+#define ZMQ_ENCODED_BUFFERS 1
+#define ZMQ_REPLY_SIZE 16
+
+#include <string>
+
+#include "codec.hpp"
+#include "sink.hpp"
+
+bool isZmqTarget(const std::string& url);
+
+// The matrix behind a ZeroMQ REQ socket. Waits for every reply, which also tells whether the matrix decodes the
+// wire format, so a slow matrix paces only this sink. Raw frames go out straight from the pooled buffer, encoded
+// ones from a small pool of the sink's own.
+class ZmqSink : public Sink {
+    void* context;
+    std::string endpoint;
+    bool negotiate = true;
+    void* socket = nullptr;
+
+    FrameEncoder encoder;
+    bool encodeFrames = false;
+    FramePool encodedPool;
+    // The encoder deltas against the pixels of the last frame, the reference keeps them from being reused
+    FrameBuffer* reference = nullptr;
+    // Buffer of a message ZMQ may still read from, released once the reply is in or the socket is closed
+    FrameBuffer* inFlight = nullptr;
+    unsigned char reply[ZMQ_REPLY_SIZE] = {};
+
+    // Replaces a REQ socket whose reply was lost, it would refuse to send again
+    void reopen();
+protected:
+    // tcp://, ipc:// or inproc:// endpoint, ?wire=auto|raw as --wire. A pixel range is sent as a count x 1 frame.
+    void configure(const OutputUrl& parsed, int width, int height) override;
+    void open() override;
+    void close() override;
+    bool send(FrameBuffer* frame) override;
+    // The encoder's reference frame
+    int extraBuffers() const override { return 1; }
+public:
+    explicit ZmqSink(void* context) : context(context) {}
+};
+
+
+
+#endif //ZMQSINK_HPP